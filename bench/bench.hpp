@@ -0,0 +1,92 @@
+/*
+* bench/bench.hpp
+*
+* Common helpers of benchmark programs: timing and generated configs.
+* Every benchmark is one file, build it from bench directory:
+*   g++ -std=c++17 -O2 -pthread bench_parse.cpp -o bench_parse
+*
+* Licensed under GNU General Public License v3
+*
+* Author: Kuzin Andrey <kuzinandrey@yandex.ru>
+* (c) 2021
+*/
+#ifndef CPP_PARSE_CONFIG_BENCH_H
+#define CPP_PARSE_CONFIG_BENCH_H
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <unistd.h>
+
+// Best time of reps calls of fn() in seconds
+template <class Fn>
+inline double bench_best(int reps, Fn fn) {
+	double best = 1e30;
+	for (int i = 0; i < reps; i++) {
+		auto t0 = std::chrono::steady_clock::now();
+		fn();
+		std::chrono::duration<double> d = std::chrono::steady_clock::now() - t0;
+		if (d.count() < best) best = d.count();
+	}
+	return best;
+} // bench_best()
+
+// Best time of reps calls of fn(), prepare() is called before every call
+// of fn() out of measured time (clear results of previous call)
+template <class Prepare, class Fn>
+inline double bench_best(int reps, Prepare prepare, Fn fn) {
+	double best = 1e30;
+	for (int i = 0; i < reps; i++) {
+		prepare();
+		double d = bench_best(1, fn);
+		if (d < best) best = d;
+	}
+	return best;
+} // bench_best()
+
+// Config of count options like real ones: comments, blank lines,
+// numbers, paths and quoted values, names are "option_<i>"
+inline std::string bench_make_config(size_t count) {
+	std::string s;
+	s.reserve(count * 48);
+	for (size_t i = 0; i < count; i++) {
+		switch (i % 8) {
+		case 0: s += "# section " + std::to_string(i / 8) + " of generated config\n"; break;
+		case 1: s += "\n"; break;
+		default: break;
+		}
+		s += "option_" + std::to_string(i);
+		switch (i % 4) {
+		case 0: s += " = " + std::to_string(i * 7919) + "\n"; break;
+		case 1: s += " = /var/lib/service/data_" + std::to_string(i) + ".db\n"; break;
+		case 2: s += "\t=\t\"quoted value " + std::to_string(i) + "\" # trailing comment\n"; break;
+		default: s += "=on\n"; break;
+		}
+	}
+	return s;
+} // bench_make_config()
+
+// Write data into new temporary file, return its name ("" on error),
+// remove it with unlink() after use
+inline std::string bench_temp_file(const std::string &data) {
+	char name[] = "/tmp/cpp_parse_config_bench.XXXXXX";
+	int fd = mkstemp(name);
+	if (fd < 0) return std::string();
+	size_t done = 0;
+	while (done < data.size()) {
+		ssize_t n = write(fd, data.data() + done, data.size() - done);
+		if (n <= 0) { close(fd); unlink(name); return std::string(); }
+		done += n;
+	}
+	close(fd);
+	return name;
+} // bench_temp_file()
+
+// Print one result line: name, time and throughput
+inline void bench_report(const char *name, double seconds, size_t bytes) {
+	std::printf("%-28s %9.2f ms %9.1f MB/s\n", name, seconds * 1e3, bytes / seconds / 1e6);
+} // bench_report()
+
+#endif /* CPP_PARSE_CONFIG_BENCH_H */
@@ -0,0 +1,59 @@
+/*
+* bench/bench_classify.cpp
+*
+* Bytes/sec of char classification by conf_cc() table against
+* isspace()/isalpha()/isalnum() of <cctype>, which look up locale,
+* and check that both give the same classes in "C" locale.
+*
+* Build and run from bench directory:
+*   g++ -std=c++17 -O2 bench_classify.cpp -o bench_classify
+*   ./bench_classify [options count]
+*
+* Licensed under GNU General Public License v3
+*
+* Author: Kuzin Andrey <kuzinandrey@yandex.ru>
+* (c) 2021
+*/
+#include "../cpp_parse_config.hpp"
+#include "bench.hpp"
+
+#include <cctype>
+
+// classes of c computed by <cctype> like parser did before the table
+static unsigned ctype_class(char c) {
+	int u = static_cast<unsigned char>(c);
+	unsigned cls = 0;
+	if (std::isspace(u)) cls |= CONF_CC_SPACE | CONF_CC_VALUE_END;
+	if (std::isalpha(u)) cls |= CONF_CC_ALPHA | CONF_CC_NAME;
+	if (std::isdigit(u) || c == '_') cls |= CONF_CC_NAME;
+	if (c == '#') cls |= CONF_CC_VALUE_END;
+	return cls;
+}
+
+int main(int argc, char *argv[]) {
+	size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 600000;
+	std::string data = bench_make_config(count);
+
+	for (int c = 0; c < 128; c++) {
+		if (conf_cc(static_cast<char>(c)) != ctype_class(static_cast<char>(c))) {
+			std::printf("class of %d differs\n", c);
+			return 1;
+		}
+	}
+
+	// sums are printed so loops are not thrown away
+	unsigned long sum_table = 0, sum_ctype = 0;
+	double t = bench_best(5, [&]() {
+		sum_table = 0;
+		for (char c : data) sum_table += conf_cc(c);
+	});
+	bench_report("conf_cc() table", t, data.size());
+	t = bench_best(5, [&]() {
+		sum_ctype = 0;
+		for (char c : data) sum_ctype += ctype_class(c);
+	});
+	bench_report("<cctype> functions", t, data.size());
+
+	std::printf("%zu bytes, sums %lu %lu\n", data.size(), sum_table, sum_ctype);
+	return sum_table == sum_ctype ? 0 : 1;
+}
@@ -0,0 +1,63 @@
+/*
+* bench/bench_daemon.cpp
+*
+* Loopback client of conf_daemon: lookups per second and latency
+* percentiles of conf_client::get() with cache off (every get() is a
+* round trip over Unix socket) and on, daemon runs in this process.
+*
+* Build and run from bench directory:
+*   g++ -std=c++17 -O2 -pthread bench_daemon.cpp -o bench_daemon
+*   ./bench_daemon [lookups]
+*
+* Licensed under GNU General Public License v3
+*
+* Author: Kuzin Andrey <kuzinandrey@yandex.ru>
+* (c) 2021
+*/
+#include "../cpp_parse_config_daemon.hpp"
+#include "bench.hpp"
+
+#include <algorithm>
+
+int main(int argc, char *argv[]) {
+	size_t lookups = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+	if (!lookups) lookups = 1;
+	const size_t count = 1000;
+
+	std::string file_name = bench_temp_file(bench_make_config(count));
+	if (file_name.empty()) { std::printf("can't make temp file\n"); return 1; }
+	std::string socket_path = file_name + ".sock";
+
+	conf_daemon daemon(file_name, socket_path);
+	conf_client client;
+	if (daemon.start() != 0 || client.connect(socket_path) != 0) {
+		std::printf("can't start daemon on %s\n", socket_path.c_str());
+		unlink(file_name.c_str());
+		return 1;
+	}
+
+	std::vector<std::string> keys;
+	for (size_t i = 0; i < count; i++) keys.push_back("option_" + std::to_string(i));
+
+	int ret = 0;
+	for (bool cached : { false, true }) {
+		client.use_cache(cached);
+		std::vector<double> lat(lookups);
+		std::string value;
+		auto t0 = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < lookups; i++) {
+			auto a = std::chrono::steady_clock::now();
+			if (client.get(keys[i % count], &value) != 0) ret = 1;
+			lat[i] = std::chrono::duration<double,std::micro>(std::chrono::steady_clock::now() - a).count();
+		}
+		std::chrono::duration<double> total = std::chrono::steady_clock::now() - t0;
+		std::sort(lat.begin(), lat.end());
+		std::printf("%-8s %10.0f lookups/s, p50 %7.2f us, p99 %7.2f us\n", cached ? "cached" : "uncached",
+			lookups / total.count(), lat[lookups / 2], lat[lookups * 99 / 100]);
+	}
+
+	if (ret) std::printf("LOOKUP FAILED\n");
+	daemon.stop();
+	unlink(file_name.c_str());
+	return ret;
+}
@@ -0,0 +1,61 @@
+/*
+* bench/bench_lookup.cpp
+*
+* Lookup time of conf_flat_map against std::unordered_map for configs
+* of 100, 10k and 1M options, keys are taken in random order.
+*
+* Build and run from bench directory:
+*   g++ -std=c++17 -O2 bench_lookup.cpp -o bench_lookup
+*   ./bench_lookup [lookups]
+*
+* Licensed under GNU General Public License v3
+*
+* Author: Kuzin Andrey <kuzinandrey@yandex.ru>
+* (c) 2021
+*/
+#include "../cpp_parse_config.hpp"
+#include "bench.hpp"
+
+#include <random>
+
+int main(int argc, char *argv[]) {
+	size_t lookups = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000000;
+	if (!lookups) lookups = 1;
+	int ret = 0;
+
+	for (size_t count : { 100ul, 10000ul, 1000000ul }) {
+		std::unordered_map<std::string,std::string> um;
+		std::vector<std::string> keys;
+		keys.reserve(count);
+		for (size_t i = 0; i < count; i++) {
+			keys.push_back("option_name_" + std::to_string(i * 7919));
+			um.emplace(keys.back(), "value_" + std::to_string(i));
+		}
+		conf_flat_map fm(um);
+
+		std::mt19937 rng(1);
+		std::vector<uint32_t> order(lookups);
+		for (uint32_t &k : order) k = rng() % count;
+
+		// sums are printed so loops are not thrown away
+		size_t sum_um = 0, sum_fm = 0, sum_miss = 0;
+		double t_um = bench_best(3, [&]() {
+			sum_um = 0;
+			for (uint32_t k : order) sum_um += um.find(keys[k])->second.size();
+		});
+		double t_fm = bench_best(3, [&]() {
+			sum_fm = 0;
+			for (uint32_t k : order) sum_fm += fm.get(keys[k]).size();
+		});
+		double t_miss = bench_best(3, [&]() {
+			sum_miss = 0;
+			for (uint32_t k : order) sum_miss += fm.find(std::string_view(keys[k]).substr(1));
+		});
+
+		std::printf("%8zu options: unordered_map %6.1f ns, conf_flat_map %6.1f ns, miss %6.1f ns%s\n",
+			count, t_um * 1e9 / lookups, t_fm * 1e9 / lookups, t_miss * 1e9 / lookups,
+			sum_um == sum_fm && !sum_miss ? "" : " (WRONG RESULT)");
+		if (sum_um != sum_fm || sum_miss) ret = 1;
+	}
+	return ret;
+}
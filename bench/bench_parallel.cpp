@@ -0,0 +1,47 @@
+/*
+* bench/bench_parallel.cpp
+*
+* Scaling of parse_config_parallel_buffer() on 1..32 threads against
+* single-thread parse_config_buffer(), input is generated config
+* (count options) or given file.
+*
+* Build and run from bench directory:
+*   g++ -std=c++17 -O2 -pthread bench_parallel.cpp -o bench_parallel
+*   ./bench_parallel [options count | config file]
+*
+* Licensed under GNU General Public License v3
+*
+* Author: Kuzin Andrey <kuzinandrey@yandex.ru>
+* (c) 2021
+*/
+#include "../cpp_parse_config_parallel.hpp"
+#include "bench.hpp"
+
+#include <cctype>
+
+int main(int argc, char *argv[]) {
+	std::string data;
+	if (argc > 1 && !std::isdigit(static_cast<unsigned char>(argv[1][0]))) {
+		if (conf_read_file(argv[1], &data) != 0) { std::printf("can't read %s\n", argv[1]); return 1; }
+	} else {
+		data = bench_make_config(argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000000);
+	}
+	std::printf("%zu bytes, %u cpus\n", data.size(), std::thread::hardware_concurrency());
+
+	std::unordered_map<std::string,std::string> ref, m;
+	int err = 0;
+	double base = bench_best(3, [&]() { err |= parse_config_buffer(data, &ref); });
+	bench_report("parse_config_buffer", base, data.size());
+
+	for (unsigned threads = 1; threads <= 32; threads *= 2) {
+		double t = bench_best(3, [&]() {
+			err |= parse_config_parallel_buffer(data.data(), data.size(), &m, threads);
+		});
+		char name[64];
+		std::snprintf(name, sizeof(name), "parallel %2u threads", threads);
+		bench_report(name, t, data.size());
+		if (m != ref) { std::printf("result differs from parse_config_buffer\n"); return 1; }
+	}
+	if (err) std::printf("PARSE ERROR %d\n", err);
+	return err ? 1 : 0;
+}
@@ -0,0 +1,299 @@
+/*
+* bench/bench_parse.cpp
+*
+* Parse throughput in bytes/sec of single-thread entry points against
+* the original get() per char parser, file is generated (count options)
+* or given by name. Results of every entry point are checked against
+* results of the original parser.
+*
+* Build and run from bench directory:
+*   g++ -std=c++17 -O2 bench_parse.cpp -o bench_parse
+*   ./bench_parse [options count | config file]
+*
+* Licensed under GNU General Public License v3
+*
+* Author: Kuzin Andrey <kuzinandrey@yandex.ru>
+* (c) 2021
+*/
+#include "../cpp_parse_config.hpp"
+#include "bench.hpp"
+
+#include <cctype>
+#include <fstream>
+#include <iostream>
+
+#ifndef CONF_PARAM_NAME_MAX_LEN
+#define CONF_PARAM_NAME_MAX_LEN 30 // max length of parameter (buffer size)
+#endif
+
+#ifndef CONF_PARAM_VALUE_MAX_LEN
+#define CONF_PARAM_VALUE_MAX_LEN 255 // max length of value (buffer size)
+#endif
+
+// Parser of the first version, kept as reference of speed and
+// results: ifstream get() per char, name and value copied into fixed
+// buffers, <cctype> classification
+static int baseline_parse_config(std::string file_name, std::unordered_map<std::string,std::string> *ret) {
+	if (!ret) return CONFERR_NORET;
+
+	std::ifstream fconf(file_name);
+	if (!fconf) return CONFERR_ERRFILE;
+
+	char param_name[CONF_PARAM_NAME_MAX_LEN];
+	char param_value[CONF_PARAM_VALUE_MAX_LEN];
+	int name_fill = 0;
+	int value_fill = 0;
+
+	char c;
+	int line = 1;
+	enum parse_mode {
+		parse_skip_space
+		, parse_skip_comment_line
+		, parse_param_name
+		, parse_skip_space_before_equal
+		, parse_skip_space_after_equal
+		, parse_value
+		, parse_line_end
+		, parse_value_in_single_quote
+		, parse_value_in_double_quote
+	};
+
+	parse_mode mode = parse_skip_space;
+
+	while (fconf.get(c)) {
+
+		if (c == EOF) {
+			if (mode == parse_value_in_single_quote || mode == parse_value_in_double_quote) {
+				param_value[value_fill] = 0;
+				ret->insert(std::make_pair(param_name,param_value));
+			}
+			break;
+		}
+
+		switch(mode) {
+
+		case parse_skip_space:
+			if (c == '#') { mode = parse_skip_comment_line; continue; }
+			if (c == '\n') { line++; continue; }
+			if (isalpha(c)) { // param name begin
+				param_name[0] = c;
+				name_fill = 1;
+				mode = parse_param_name;
+				continue;
+			}
+			if (!isspace(c)) {
+				std::cerr << "Error in " << file_name
+					<< ": param name can't start with not alpha char '"
+					<< c << "' on line " << line << std::endl;
+				fconf.close(); ret->clear();
+				return CONFERR_WRONGPARAM;
+			}
+		break; // parse_skip_space
+
+		case parse_skip_comment_line:
+			if (c == '\n') {
+				line++;
+				mode = parse_skip_space;
+			}
+		break; // parse_skip_comment_line
+
+		case parse_param_name:
+			if (isspace(c)) { // name end
+				if (c == '\n') line++;
+				param_name[name_fill] = 0;
+				name_fill++;
+				mode = parse_skip_space_before_equal;
+				continue;
+			}
+			if (c == '=') {
+				param_name[name_fill] = 0;
+				name_fill++;
+				mode = parse_skip_space_after_equal;
+				continue;
+			}
+			if (isalpha(c) || isdigit(c) || c == '_') {
+				param_name[name_fill] = c;
+				if (name_fill + 1 > CONF_PARAM_NAME_MAX_LEN - 1) {
+					std::cerr << "Error in " << file_name
+						<< ": param length is very big on " << line
+						<< " line" << std::endl;
+					fconf.close(); ret->clear();
+					return CONFERR_WRONGPARAM;
+				}
+				name_fill++;
+				continue;
+			} else {
+				std::cerr << "Error in " << file_name
+					<< ": wrong char in param name '" << c << "' on "
+					<< line << " line" << std::endl;
+				fconf.close(); ret->clear();
+				return CONFERR_WRONGPARAM;
+			}
+		break; // parse_param_name
+
+		case parse_skip_space_before_equal:
+			if (isspace(c)) {
+				if (c == '\n') line++;
+				continue;
+			}
+			if (c == '=') {
+				mode = parse_skip_space_after_equal;
+			}
+		break; // parse_skip_space_before_equal
+
+		case parse_skip_space_after_equal:
+			if (isspace(c)) { if (c == '\n') line++; continue; }
+			if (c == '\'') { mode = parse_value_in_single_quote; value_fill = 0; continue; }
+			if (c == '"') { mode = parse_value_in_double_quote; value_fill = 0; continue; }
+			if (c == '#') { // empty param value (comment line)
+				value_fill = 0;
+				param_value[value_fill] = 0;
+				ret->insert(std::make_pair(param_name,param_value));
+				mode = parse_skip_comment_line;
+				continue;
+			}
+			param_value[0] = c;
+			value_fill = 1;
+			mode = parse_value;
+		break; // parse_skip_space_after_equal
+
+		case parse_value:
+			if (isspace(c) || c == '#') {
+				mode = parse_line_end;
+				if (c == '#') mode = parse_skip_comment_line;
+				param_value[value_fill] = 0;
+				value_fill++;
+				ret->insert(std::make_pair(param_name,param_value));
+				if (c == '\n') { line++; mode = parse_skip_space; }
+				continue;
+			}
+			param_value[value_fill] = c;
+			if (value_fill + 1 > CONF_PARAM_VALUE_MAX_LEN - 1) {
+				std::cerr << "Error in " << file_name << ": value length is very big on " << line << " line" << std::endl;
+				fconf.close(); ret->clear();
+				return CONFERR_WRONGVALUE;
+			}
+			value_fill++;
+		break; // parse_value
+
+		case parse_line_end:
+			if (isspace(c)) {
+				if (c == '\n') { line++; mode = parse_skip_space; }
+				continue;
+			}
+			if (c == '#') {
+				mode = parse_skip_comment_line;
+				continue;
+			}
+			std::cerr << "Error in " << file_name
+				<< ": wrong char '" << c
+				<< "' on " << line << " line" << std::endl;
+			fconf.close(); ret->clear();
+			return CONFERR_WRONGSYNTAX;
+		break; // parse_line_end
+
+		case parse_value_in_single_quote:
+			if (c != '\'' ){
+				if (c == '\n') line++;
+				param_value[value_fill] = c;
+				if (value_fill + 1 > CONF_PARAM_VALUE_MAX_LEN - 1) {
+					std::cerr << "Error in " << file_name
+						<< ": value length is very big on"
+						<< line << " line" << std::endl;
+					fconf.close(); ret->clear();
+					return CONFERR_WRONGVALUE;
+				}
+				value_fill++;
+				continue;
+			}
+			param_value[value_fill] = 0;
+			value_fill++;
+			ret->insert(std::make_pair(param_name, param_value));
+			mode = parse_skip_space;
+		break; // parse_value_in_single_quote
+
+		case parse_value_in_double_quote:
+			if (c != '\"' ){
+				if (c == '\n') line++;
+				param_value[value_fill] = c;
+				if (value_fill + 1 > CONF_PARAM_VALUE_MAX_LEN - 1) {
+					std::cerr << "Error in " << file_name
+						<< ": value length is very big on "
+						<< line << " line" << std::endl;
+					fconf.close(); ret->clear();
+					return CONFERR_WRONGVALUE;
+				}
+				value_fill++;
+				continue;
+			}
+			param_value[value_fill] = 0;
+			value_fill++;
+			ret->insert(std::make_pair(param_name, param_value));
+			mode = parse_skip_space;
+		break; // parse_value_in_double_quote
+
+		} // switch
+	} // while read conf
+
+	return 0; // success
+} // baseline_parse_config()
+
+int main(int argc, char *argv[]) {
+	std::string file_name;
+	bool temp = false;
+	if (argc > 1 && !std::isdigit(static_cast<unsigned char>(argv[1][0]))) {
+		file_name = argv[1];
+	} else {
+		size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 600000;
+		file_name = bench_temp_file(bench_make_config(count));
+		temp = true;
+	}
+	if (file_name.empty()) { std::printf("can't make temp file\n"); return 1; }
+
+	std::ifstream in(file_name, std::ios::binary);
+	std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	std::printf("%s: %zu bytes\n", file_name.c_str(), data.size());
+
+	std::unordered_map<std::string,std::string> m, reference;
+	int err = 0;
+	int differ = 0;
+
+	// reading alone the way parser did before block reads
+	size_t lines = 0;
+	double t = bench_best(3, [&]() {
+		std::ifstream f(file_name);
+		lines = 0;
+		for (char c; f.get(c); ) lines += c == '\n';
+	});
+	bench_report("ifstream get() read only", t, data.size());
+
+	t = bench_best(3, [&]() { reference.clear(); }, [&]() { err |= baseline_parse_config(file_name, &reference); });
+	bench_report("baseline_parse_config", t, data.size());
+
+	// every rep fills m from empty, results are compared with baseline
+	auto clear = [&]() { m.clear(); };
+	t = bench_best(5, clear, [&]() { err |= parse_config(file_name, &m); });
+	bench_report("parse_config", t, data.size());
+	differ += m != reference;
+	t = bench_best(5, clear, [&]() { err |= parse_config_mmap(file_name, &m); });
+	bench_report("parse_config_mmap", t, data.size());
+	differ += m != reference;
+	t = bench_best(5, clear, [&]() { err |= parse_config_buffer(data, &m); });
+	bench_report("parse_config_buffer", t, data.size());
+	differ += m != reference;
+
+	conf_view v;
+	t = bench_best(5, [&]() { err |= parse_config_view(file_name, &v); });
+	bench_report("parse_config_view", t, data.size());
+	differ += v.size() != reference.size();
+	for (auto &kv : reference) differ += v.get(kv.first) != kv.second;
+
+	conf_null_sink null_sink;
+	t = bench_best(5, [&]() { err |= conf_parse_all(data.data(), data.size(), conf_buffer_name, null_sink); });
+	bench_report("conf_parse_all (no result)", t, data.size());
+
+	std::printf("%zu lines, %zu options%s%s\n", lines, reference.size(),
+		err ? ", PARSE ERROR" : "", differ ? ", RESULTS DIFFER FROM BASELINE" : "");
+	if (temp) unlink(file_name.c_str());
+	return err || differ ? 1 : 0;
+}
@@ -0,0 +1,93 @@
+/*
+* bench/bench_rcu.cpp
+*
+* Reader contention of conf_rcu against std::shared_mutex on 1..128
+* reader threads while one writer publishes new config generation
+* every millisecond. Every reader looks up one option per read section.
+*
+* Build and run from bench directory:
+*   g++ -std=c++17 -O2 -pthread bench_rcu.cpp -o bench_rcu
+*   ./bench_rcu [milliseconds per run]
+*
+* Licensed under GNU General Public License v3
+*
+* Author: Kuzin Andrey <kuzinandrey@yandex.ru>
+* (c) 2021
+*/
+#include "../cpp_parse_config.hpp"
+#include "../cpp_parse_config_rcu.hpp"
+#include "bench.hpp"
+
+#include <memory>
+#include <shared_mutex>
+#include <vector>
+
+typedef std::unordered_map<std::string,std::string> conf_map;
+
+static conf_map *make_map(size_t gen) {
+	conf_map *m = new conf_map();
+	for (int i = 0; i < 64; i++) (*m)["option_" + std::to_string(i)] = std::to_string(gen);
+	return m;
+}
+
+// Run threads readers for ms milliseconds with writer calling update()
+// every millisecond, read() returns size of looked up value. Readers
+// stop by the clock themselves, so starved writer can't stretch a run.
+// return reads per second of all readers, *updates is number of updates
+template <class Read, class Update>
+static double run(unsigned threads, int ms, Read read, Update update, size_t *updates) {
+	auto t0 = std::chrono::steady_clock::now();
+	auto deadline = t0 + std::chrono::milliseconds(ms);
+	std::atomic<unsigned long> total{0};
+	std::vector<std::thread> pool;
+	for (unsigned t = 0; t < threads; t++) {
+		pool.emplace_back([&, t]() {
+			std::string key = "option_" + std::to_string(t % 64);
+			unsigned long n = 0, sum = 0;
+			while (std::chrono::steady_clock::now() < deadline) {
+				for (int i = 0; i < 64; i++) sum += read(key);
+				n += 64;
+			}
+			total += n + (sum == 0); // sum is used so reads stay
+		});
+	}
+	size_t gen = 0;
+	while (std::chrono::steady_clock::now() < deadline) {
+		update(++gen);
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	for (std::thread &th : pool) th.join();
+	std::chrono::duration<double> d = std::chrono::steady_clock::now() - t0;
+	*updates = gen;
+	return total / d.count();
+}
+
+int main(int argc, char *argv[]) {
+	int ms = argc > 1 ? std::atoi(argv[1]) : 500;
+	std::printf("cpus %u, %d ms per run, reads/s of all threads\n", std::thread::hardware_concurrency(), ms);
+	std::printf("%8s %16s %8s %16s %8s\n", "threads", "conf_rcu", "updates", "shared_mutex", "updates");
+
+	for (unsigned threads = 1; threads <= 128; threads *= 2) {
+		size_t u_rcu, u_mutex;
+		conf_rcu<conf_map> rcu(make_map(0));
+		double r_rcu = run(threads, ms,
+			[&](const std::string &key) { return rcu.read()->find(key)->second.size(); },
+			[&](size_t gen) { rcu.update(make_map(gen)); }, &u_rcu);
+
+		std::shared_mutex lock;
+		std::shared_ptr<conf_map> current(make_map(0));
+		double r_mutex = run(threads, ms,
+			[&](const std::string &key) {
+				std::shared_lock<std::shared_mutex> guard(lock);
+				return current->find(key)->second.size();
+			},
+			[&](size_t gen) {
+				std::shared_ptr<conf_map> fresh(make_map(gen));
+				std::unique_lock<std::shared_mutex> guard(lock);
+				current.swap(fresh);
+			}, &u_mutex);
+
+		std::printf("%8u %16.0f %8zu %16.0f %8zu\n", threads, r_rcu, u_rcu, r_mutex, u_mutex);
+	}
+	return 0;
+}
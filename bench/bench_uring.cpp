@@ -0,0 +1,81 @@
+/*
+* bench/bench_uring.cpp
+*
+* Loading of many small config files: parse_config_batch_uring() in
+* one thread against parse_config_batch() pool of blocking reads on
+* 1..32 threads. Files are in page cache (warm) or dropped from it with
+* posix_fadvise(POSIX_FADV_DONTNEED) before every run (cold).
+*
+* Build and run from bench directory:
+*   g++ -std=c++17 -O2 -pthread bench_uring.cpp -o bench_uring
+*   ./bench_uring [files [directory]]
+*
+* Licensed under GNU General Public License v3
+*
+* Author: Kuzin Andrey <kuzinandrey@yandex.ru>
+* (c) 2021
+*/
+#include "../cpp_parse_config_uring.hpp"
+#include "bench.hpp"
+
+#include <sys/stat.h>
+
+// drop pages of files from page cache (works for files not written
+// since last sync, so files are synced once after creation)
+static void drop_cache(const std::vector<std::string> &files) {
+	for (const std::string &f : files) {
+		int fd = open(f.c_str(), O_RDONLY);
+		if (fd < 0) continue;
+		posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+		close(fd);
+	}
+}
+
+int main(int argc, char *argv[]) {
+	size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 5000;
+	std::string dir = argc > 2 ? argv[2] : "/tmp/cpp_parse_config_bench_uring";
+	mkdir(dir.c_str(), 0700);
+
+	std::vector<std::string> files;
+	size_t bytes = 0;
+	for (size_t i = 0; i < count; i++) {
+		std::string text = bench_make_config(20 + i % 200);
+		files.push_back(dir + "/tenant" + std::to_string(i) + ".conf");
+		FILE *f = std::fopen(files.back().c_str(), "wb");
+		if (!f || std::fwrite(text.data(), 1, text.size(), f) != text.size()) {
+			std::printf("can't write %s\n", files.back().c_str());
+			return 1;
+		}
+		std::fclose(f);
+		bytes += text.size();
+	}
+	sync();
+	std::printf("%zu files, %zu bytes, %u cpus\n", count, bytes, std::thread::hardware_concurrency());
+
+	std::vector<conf_file_result> ref, res;
+	int err = parse_config_batch(files, &ref, 1);
+	for (bool cold : { false, true }) {
+		std::printf("%s page cache\n", cold ? "cold" : "warm");
+		auto run = [&](const char *name, auto load) {
+			double best = 1e30;
+			for (int rep = 0; rep < 3; rep++) {
+				if (cold) drop_cache(files);
+				best = std::min(best, bench_best(1, [&]() { err |= load(); }));
+				for (size_t i = 0; i < files.size(); i++)
+					if (res[i].values != ref[i].values) { std::printf("%s: result differs\n", name); std::exit(1); }
+			}
+			bench_report(name, best, bytes);
+		};
+		run("uring depth 64", [&]() { return parse_config_batch_uring(files, &res, 64); });
+		for (unsigned threads = 1; threads <= 32; threads *= 2) {
+			char name[64];
+			std::snprintf(name, sizeof(name), "batch %2u threads", threads);
+			run(name, [&]() { return parse_config_batch(files, &res, threads); });
+		}
+	}
+
+	for (const std::string &f : files) unlink(f.c_str());
+	rmdir(dir.c_str());
+	if (err) std::printf("PARSE ERROR\n");
+	return err ? 1 : 0;
+}
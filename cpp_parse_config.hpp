@@ -8,6 +8,7 @@
 * of paired std::string ("options"=>"value")
 *
 * See usage example at the end of file.
+* Requires C++17.
 *
 * Licensed under GNU General Public License v3
 *
@@ -17,10 +18,38 @@
 #ifndef CPP_PARSE_CONFIG_H
 #define CPP_PARSE_CONFIG_H
 
-#include <iostream>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <new>
 #include <fstream>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <tuple>
 #include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CONF_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if !defined(CONF_NO_SIMD) && defined(__GNUC__) && defined(__SSE2__) \
+	&& (defined(__x86_64__) || defined(__i386__))
+#define CONF_HAVE_SSE2 1
+#include <immintrin.h>
+#endif
 
 // some return error codes
 #define CONFERR_NORET -1 // no valid pointer to return container
@@ -29,29 +58,243 @@
 #define CONFERR_WRONGPARAM -4 // wrong parameter name
 #define CONFERR_WRONGVALUE -5 // wrong parameter value
 
-#ifndef CONF_PARAM_NAME_MAX_LEN
-#define CONF_PARAM_NAME_MAX_LEN 30 // max length of parameter (buffer size)
+#ifndef CONF_READ_BLOCK_SIZE
+#define CONF_READ_BLOCK_SIZE 65536 // size of block read from config file at once
 #endif
 
-#ifndef CONF_PARAM_VALUE_MAX_LEN
-#define CONF_PARAM_VALUE_MAX_LEN 255 // max length of value (buffer size)
+#ifndef CONF_ARENA_BLOCK_SIZE
+#define CONF_ARENA_BLOCK_SIZE 65536 // min size of first block of conf_arena
 #endif
 
-// Parse config file file_name and fill the unordered_map of strings "option"=>"value"
-// return 0 on success or some error code
-int parse_config(std::string file_name, std::unordered_map<std::string,std::string> *ret) {
-	if (!ret) return CONFERR_NORET;
+// flags of conf_parse_all() and conf_parse_file()
+#define CONF_PARSE_RECOVER 0x1 // skip line with syntax error and go on
+#define CONF_PARSE_SECTIONS 0x2 // [section] headers and dotted names
 
-	std::ifstream fconf(file_name);
-	if (!fconf) return CONFERR_ERRFILE;
+// name of input in error reports when config is parsed from memory
+inline const std::string conf_buffer_name = "<buffer>";
 
-	char param_name[CONF_PARAM_NAME_MAX_LEN];
-	char param_value[CONF_PARAM_VALUE_MAX_LEN];
-	int name_fill = 0;
-	int value_fill = 0;
+// Character classes used by parser, same as isspace()/isalpha()/isalnum()
+// in "C" locale but without locale lookup and defined for any byte,
+// bytes >= 0x80 (UTF-8) have no class
+enum conf_char_class {
+	CONF_CC_SPACE = 1 // ' ', '\t', '\n', '\v', '\f', '\r'
+	, CONF_CC_ALPHA = 2 // first char of param name
+	, CONF_CC_NAME = 4 // next chars of param name: alpha, digit and '_'
+	, CONF_CC_VALUE_END = 8 // end of value without quotes: space or '#'
+};
 
-	char c;
-	int line = 1;
+struct conf_char_table {
+	unsigned char cls[256];
+};
+
+constexpr conf_char_table conf_make_char_table() {
+	conf_char_table t = {};
+	for (int c = 0; c < 256; c++) {
+		unsigned char cls = 0;
+		if (c == ' ' || (c >= '\t' && c <= '\r')) cls |= CONF_CC_SPACE | CONF_CC_VALUE_END;
+		if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) cls |= CONF_CC_ALPHA | CONF_CC_NAME;
+		if ((c >= '0' && c <= '9') || c == '_') cls |= CONF_CC_NAME;
+		if (c == '#') cls |= CONF_CC_VALUE_END;
+		t.cls[c] = cls;
+	}
+	return t;
+}
+
+inline constexpr conf_char_table conf_char_classes = conf_make_char_table();
+
+inline unsigned conf_cc(char c) {
+	return conf_char_classes.cls[static_cast<unsigned char>(c)];
+}
+
+// Structural scanner: find next byte the state machine is interested in
+// 16 (SSE2) or 32 (AVX2) bytes at a time, so long comments, values and
+// quoted strings are skipped without going through switch per byte.
+// Implementation is selected once at runtime by CPU features,
+// define CONF_NO_SIMD to use only scalar code.
+struct conf_scanner {
+	// first '\n' in [p, end) or end
+	const char *(*newline)(const char *p, const char *end);
+	// first space char or '#' in [p, end) or end
+	const char *(*value_end)(const char *p, const char *end);
+	// first q or '\n' in [p, end) or end
+	const char *(*quote)(const char *p, const char *end, char q);
+};
+
+inline const char *conf_scan_newline_scalar(const char *p, const char *end) {
+	const void *nl = std::memchr(p, '\n', end - p);
+	return nl ? static_cast<const char *>(nl) : end;
+}
+
+inline const char *conf_scan_value_end_scalar(const char *p, const char *end) {
+	while (p < end && !(conf_cc(*p) & CONF_CC_VALUE_END)) p++;
+	return p;
+}
+
+inline const char *conf_scan_quote_scalar(const char *p, const char *end, char q) {
+	while (p < end && *p != q && *p != '\n') p++;
+	return p;
+}
+
+#ifdef CONF_HAVE_SSE2
+inline const char *conf_scan_newline_sse2(const char *p, const char *end) {
+	const __m128i nl = _mm_set1_epi8('\n');
+	for (; end - p >= 16; p += 16) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+		int m = _mm_movemask_epi8(_mm_cmpeq_epi8(v, nl));
+		if (m) return p + __builtin_ctz(m);
+	}
+	return conf_scan_newline_scalar(p, end);
+}
+
+inline const char *conf_scan_value_end_sse2(const char *p, const char *end) {
+	const __m128i sp = _mm_set1_epi8(' ');
+	const __m128i hash = _mm_set1_epi8('#');
+	const __m128i ctl_lo = _mm_set1_epi8('\t' - 1);
+	const __m128i ctl_hi = _mm_set1_epi8('\r' + 1);
+	for (; end - p >= 16; p += 16) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+		__m128i m = _mm_or_si128(_mm_cmpeq_epi8(v, sp), _mm_cmpeq_epi8(v, hash));
+		// '\t' .. '\r' range, bytes >= 0x80 are negative so never match
+		m = _mm_or_si128(m, _mm_and_si128(_mm_cmpgt_epi8(v, ctl_lo), _mm_cmplt_epi8(v, ctl_hi)));
+		int mask = _mm_movemask_epi8(m);
+		if (mask) return p + __builtin_ctz(mask);
+	}
+	return conf_scan_value_end_scalar(p, end);
+}
+
+inline const char *conf_scan_quote_sse2(const char *p, const char *end, char q) {
+	const __m128i nl = _mm_set1_epi8('\n');
+	const __m128i qv = _mm_set1_epi8(q);
+	for (; end - p >= 16; p += 16) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+		int m = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, nl), _mm_cmpeq_epi8(v, qv)));
+		if (m) return p + __builtin_ctz(m);
+	}
+	return conf_scan_quote_scalar(p, end, q);
+}
+
+__attribute__((target("avx2")))
+inline const char *conf_scan_newline_avx2(const char *p, const char *end) {
+	const __m256i nl = _mm256_set1_epi8('\n');
+	for (; end - p >= 32; p += 32) {
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+		unsigned m = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl));
+		if (m) return p + __builtin_ctz(m);
+	}
+	return conf_scan_newline_sse2(p, end);
+}
+
+__attribute__((target("avx2")))
+inline const char *conf_scan_value_end_avx2(const char *p, const char *end) {
+	const __m256i sp = _mm256_set1_epi8(' ');
+	const __m256i hash = _mm256_set1_epi8('#');
+	const __m256i ctl_lo = _mm256_set1_epi8('\t' - 1);
+	const __m256i ctl_hi = _mm256_set1_epi8('\r' + 1);
+	for (; end - p >= 32; p += 32) {
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+		__m256i m = _mm256_or_si256(_mm256_cmpeq_epi8(v, sp), _mm256_cmpeq_epi8(v, hash));
+		m = _mm256_or_si256(m, _mm256_and_si256(_mm256_cmpgt_epi8(v, ctl_lo), _mm256_cmpgt_epi8(ctl_hi, v)));
+		unsigned mask = _mm256_movemask_epi8(m);
+		if (mask) return p + __builtin_ctz(mask);
+	}
+	return conf_scan_value_end_sse2(p, end);
+}
+
+__attribute__((target("avx2")))
+inline const char *conf_scan_quote_avx2(const char *p, const char *end, char q) {
+	const __m256i nl = _mm256_set1_epi8('\n');
+	const __m256i qv = _mm256_set1_epi8(q);
+	for (; end - p >= 32; p += 32) {
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+		unsigned m = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, nl), _mm256_cmpeq_epi8(v, qv)));
+		if (m) return p + __builtin_ctz(m);
+	}
+	return conf_scan_quote_sse2(p, end, q);
+}
+#endif /* CONF_HAVE_SSE2 */
+
+// Scanner for this CPU, selected on first call
+inline const conf_scanner &conf_scan() {
+	static const conf_scanner scanner = []() {
+		conf_scanner s = { conf_scan_newline_scalar, conf_scan_value_end_scalar, conf_scan_quote_scalar };
+#ifdef CONF_HAVE_SSE2
+		s = { conf_scan_newline_sse2, conf_scan_value_end_sse2, conf_scan_quote_sse2 };
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			s = { conf_scan_newline_avx2, conf_scan_value_end_avx2, conf_scan_quote_avx2 };
+#endif
+		return s;
+	}();
+	return scanner;
+} // conf_scan()
+
+// Parse error with its place in input
+struct conf_error {
+	int code = 0; // CONFERR_*
+	int line = 0; // from 1
+	int column = 0; // byte in line, from 1
+	size_t offset = 0; // byte offset from input begin
+	char c = 0; // wrong char
+	const char *what = ""; // description of error
+	std::string_view file_name; // valid only during handler call
+};
+
+// Handler of parse errors, arg is given to conf_on_error() together with it
+typedef void (*conf_error_fn)(const conf_error &err, void *arg);
+
+struct conf_error_handler {
+	conf_error_fn fn = nullptr;
+	void *arg = nullptr;
+};
+
+// Error handler of calling thread, by default there is none and errors
+// are only returned as codes, nothing is printed
+inline conf_error_handler &conf_thread_error_handler() {
+	static thread_local conf_error_handler handler;
+	return handler;
+} // conf_thread_error_handler()
+
+// Set handler of parse errors of calling thread (nullptr - no handler)
+inline void conf_on_error(conf_error_fn fn, void *arg = nullptr) {
+	conf_thread_error_handler().fn = fn;
+	conf_thread_error_handler().arg = arg;
+} // conf_on_error()
+
+// Handler which prints error to stderr: conf_on_error(conf_print_error);
+inline void conf_print_error(const conf_error &err, void *) {
+	std::fprintf(stderr, "Error in %.*s: %s '%c' on line %d column %d\n",
+		static_cast<int>(err.file_name.size()), err.file_name.data(),
+		err.what, err.c, err.line, err.column);
+} // conf_print_error()
+
+// Error handler of calling thread given to worker or background
+// threads: capture it with to = conf_thread_error_handler() and install
+// conf_on_error(conf_error_relay::call, &relay) in the other thread.
+// Calls through relay are serialized, so handler which is not
+// thread-safe works as before
+struct conf_error_relay {
+	conf_error_handler to; // handler of calling thread
+	std::mutex lock;
+
+	static void call(const conf_error &err, void *arg) {
+		conf_error_relay *r = static_cast<conf_error_relay *>(arg);
+		std::lock_guard<std::mutex> guard(r->lock);
+		r->to.fn(err, r->to.arg);
+	}
+
+	// install relay as handler of calling thread if there is handler to
+	// relay to
+	void install() {
+		if (to.fn) conf_on_error(call, this);
+	}
+};
+
+// State of config parser, kept between calls of conf_parse_block()
+// so input can be fed by blocks of any size.
+// Option name and value are not copied, parser remembers where they
+// begin in input, so pending bytes must stay in place (or be moved
+// together with rebase()) until option is complete.
+struct conf_parser {
 	enum parse_mode {
 		parse_skip_space
 		, parse_skip_comment_line
@@ -62,218 +305,1494 @@ int parse_config(std::string file_name, std::unordered_map<std::string,std::stri
 		, parse_line_end
 		, parse_value_in_single_quote
 		, parse_value_in_double_quote
+		, parse_section
 	};
 
 	parse_mode mode = parse_skip_space;
+	int line = 1;
+	bool quiet = false; // don't report errors (speculative parse of a chunk)
+	bool recover = false; // report error and go on from next line (validation)
+	bool sections = false; // [section] headers and dotted names
+	int first_error = 0; // code of the first error skipped in recover mode
+	int errors = 0; // number of errors skipped in recover mode
+	size_t offset = 0; // input offset of next block begin
+	size_t line_offset = 0; // input offset of current line begin, known at block end
 
-	while (fconf.get(c)) {
+	const char *name_begin = nullptr;
+	const char *name_end = nullptr;
+	const char *value_begin = nullptr;
 
-		if (c == EOF) {
-			if (mode == parse_value_in_single_quote || mode == parse_value_in_double_quote) {
-				param_value[value_fill] = 0;
-				ret->insert(std::make_pair(param_name,param_value));
-			}
-			break;
+	std::string section; // name of current [section], prefix of names
+	std::string key; // "section.name" passed to sink
+
+	// set options of parser by CONF_PARSE_* flags
+	void set_flags(unsigned flags) {
+		recover = flags & CONF_PARSE_RECOVER;
+		sections = flags & CONF_PARSE_SECTIONS;
+	}
+
+	// first input byte still referenced by unfinished option or nullptr
+	const char *pending() const {
+		switch (mode) {
+		case parse_param_name:
+		case parse_skip_space_before_equal:
+		case parse_skip_space_after_equal:
+		case parse_value:
+		case parse_value_in_single_quote:
+		case parse_value_in_double_quote:
+		case parse_section:
+			return name_begin;
+		default:
+			return nullptr;
 		}
+	}
+
+	// pending bytes which began at from are copied to to, both buffers
+	// are still valid: pointers are moved as offsets from from
+	void rebase(const char *from, const char *to) {
+		if (name_begin) name_begin = to + (name_begin - from);
+		if (name_end) name_end = to + (name_end - from);
+		if (value_begin) value_begin = to + (value_begin - from);
+	}
+};
+
+// Pass error at p of block [block_begin, ...) to error handler of thread
+// return code
+inline int conf_report(const conf_parser *st, int code, const char *what,
+	const char *block_begin, const char *p, int line, const std::string &file_name)
+{
+	conf_error_handler &h = conf_thread_error_handler();
+	if (st->quiet || !h.fn) return code;
+
+	conf_error err;
+	err.code = code;
+	err.line = line;
+	err.offset = st->offset + (p - block_begin);
+	size_t line_begin = st->line_offset;
+	for (const char *q = p; q > block_begin; q--) {
+		if (q[-1] == '\n') { line_begin = st->offset + (q - block_begin); break; }
+	}
+	err.column = static_cast<int>(err.offset - line_begin) + 1;
+	err.c = *p;
+	err.what = what;
+	err.file_name = file_name;
+	h.fn(err, h.arg);
+	return code;
+} // conf_report()
+
+// Pass option to sink, sink may return void or int error code which
+// stops parsing when not 0
+template <class Sink>
+inline int conf_emit(Sink &sink, std::string_view name, std::string_view value) {
+	if constexpr (std::is_void_v<decltype(sink(name, value))>) {
+		sink(name, value);
+		return 0;
+	} else {
+		return sink(name, value);
+	}
+} // conf_emit()
+
+// Pass option to sink, name is prefixed by current [section] if any
+template <class Sink>
+inline int conf_emit_option(conf_parser *st, Sink &sink, std::string_view name, std::string_view value) {
+	if (st->section.empty()) return conf_emit(sink, name, value);
+	st->key.assign(st->section).append(1, '.').append(name);
+	return conf_emit(sink, st->key, value);
+} // conf_emit_option()
+
+// Check dotted name [p, end) which begins with alpha char: every part
+// after '.' must begin with alpha char too
+// return wrong '.' or nullptr if name is right
+inline const char *conf_dotted_name_error(const char *p, const char *end) {
+	for (; p < end; p++) {
+		if (*p == '.' && (p + 1 == end || !(conf_cc(p[1]) & CONF_CC_ALPHA))) return p;
+	}
+	return nullptr;
+} // conf_dotted_name_error()
+
+// Check section name between '[' and ']', spaces around it are cut off
+// from [*begin, *end)
+// return wrong char (*end for empty name) or nullptr if name is right
+inline const char *conf_section_name_error(const char **begin, const char **end) {
+	const char *b = *begin;
+	const char *e = *end;
+	while (b < e && (conf_cc(*b) & CONF_CC_SPACE)) b++;
+	while (e > b && (conf_cc(e[-1]) & CONF_CC_SPACE)) e--;
+	*begin = b;
+	*end = e;
+	if (b == e) return e;
+	if (!(conf_cc(*b) & CONF_CC_ALPHA)) return b;
+	for (const char *p = b; p < e; p++) {
+		if (!(conf_cc(*p) & CONF_CC_NAME) && *p != '.') return p;
+	}
+	return conf_dotted_name_error(b, e);
+} // conf_section_name_error()
+
+// Run parser over block of bytes [p, end) and pass every complete option
+// to sink(std::string_view name, std::string_view value), views point
+// into input bytes
+// Transitions are kept in switch, not in [mode][char class] table: every
+// case sets next mode by constant, so compiler jumps straight to the next
+// case, while mode loaded from table costs lookup and indirect jump per
+// byte (bench_parse: 8-10% slower, no gain on space aligned configs).
+// return 0 on success or some error code (of parser or sink)
+template <class Sink>
+inline int conf_parse_block(conf_parser *st, const char *p, const char *end,
+	const std::string &file_name, Sink &sink)
+{
+	// keep hot state in locals, write back when block is done
+	const char *block_begin = p;
+	conf_parser::parse_mode mode = st->mode;
+	int line = st->line;
+	const char *name_begin = st->name_begin;
+	const char *name_end = st->name_end;
+	const char *value_begin = st->value_begin;
+	const bool sections = st->sections;
+	const conf_scanner &scan = conf_scan();
+	int err = 0;
+
+	for (; p < end; p++) {
+		char c = *p;
 
 		switch(mode) {
 
-		case parse_skip_space:
-			if (c == '#') { mode = parse_skip_comment_line; continue; }
+		case conf_parser::parse_skip_space:
+			if (c == '#') { mode = conf_parser::parse_skip_comment_line; continue; }
 			if (c == '\n') { line++; continue; }
-			if (isalpha(c)) { // param name begin
-				param_name[0] = c;
-				name_fill = 1;
-				mode = parse_param_name;
+			if (conf_cc(c) & CONF_CC_ALPHA) { // param name begin
+				name_begin = p;
+				mode = conf_parser::parse_param_name;
 				continue;
 			}
-			if (!isspace(c)) {
-				std::cerr << "Error in " << file_name
-					<< ": param name can't start with not alpha char '"
-					<< c << "' on line " << line << std::endl;
-				fconf.close(); ret->clear();
-				return CONFERR_WRONGPARAM;
+			if (!(conf_cc(c) & CONF_CC_SPACE)) {
+				if (c == '[' && sections) {
+					name_begin = p; // '[' is kept with section name in input
+					mode = conf_parser::parse_section;
+					continue;
+				}
+				err = conf_report(st, CONFERR_WRONGPARAM, "param name can't start with not alpha char",
+					block_begin, p, line, file_name);
+				if (!st->recover) return err;
+				goto skip_line;
 			}
 		break; // parse_skip_space
 
-		case parse_skip_comment_line:
-			if (c == '\n') {
-				line++;
-				mode = parse_skip_space;
-			}
+		case conf_parser::parse_skip_comment_line:
+			p = scan.newline(p, end);
+			if (p == end) { p--; continue; } // comment goes on in next block
+			line++;
+			mode = conf_parser::parse_skip_space;
 		break; // parse_skip_comment_line
 
-		case parse_param_name:
-			if (isspace(c)) { // name end
-				if (c == '\n') line++;
-				param_name[name_fill] = 0;
-				name_fill++;
-				mode = parse_skip_space_before_equal;
+		case conf_parser::parse_param_name:
+			if (conf_cc(c) & CONF_CC_NAME) {
+				// take the whole run of name chars at once
+				while (p + 1 < end && (conf_cc(p[1]) & CONF_CC_NAME)) p++;
 				continue;
 			}
-			if (c == '=') {
-				param_name[name_fill] = 0;
-				name_fill++;
-				mode = parse_skip_space_after_equal;
+			if (sections) {
+				if (c == '.') continue; // dotted name, checked at its end
+				if (c == '=' || (conf_cc(c) & CONF_CC_SPACE)) {
+					const char *dot = conf_dotted_name_error(name_begin, p);
+					if (dot) {
+						err = conf_report(st, CONFERR_WRONGPARAM, "wrong dot in param name",
+							block_begin, dot, line, file_name);
+						if (!st->recover) return err;
+						goto skip_line;
+					}
+				}
+			}
+			if (conf_cc(c) & CONF_CC_SPACE) { // name end
+				if (c == '\n') line++;
+				name_end = p;
+				mode = conf_parser::parse_skip_space_before_equal;
 				continue;
 			}
-			if (isalpha(c) || isdigit(c) || c == '_') {
-				param_name[name_fill] = c;
-				if (name_fill + 1 > CONF_PARAM_NAME_MAX_LEN - 1) {
-					std::cerr << "Error in " << file_name
-						<< ": param length is very big on " << line
-						<< " line" << std::endl;
-					fconf.close(); ret->clear();
-					return CONFERR_WRONGPARAM;
-				}
-				name_fill++;
+			if (c == '=') {
+				name_end = p;
+				mode = conf_parser::parse_skip_space_after_equal;
 				continue;
-			} else {
-				std::cerr << "Error in " << file_name
-					<< ": wrong char in param name '" << c << "' on "
-					<< line << " line" << std::endl;
-				fconf.close(); ret->clear();
-				return CONFERR_WRONGPARAM;
 			}
+			err = conf_report(st, CONFERR_WRONGPARAM, "wrong char in param name",
+				block_begin, p, line, file_name);
+			if (!st->recover) return err;
+			goto skip_line;
 		break; // parse_param_name
 
-		case parse_skip_space_before_equal:
-			if (isspace(c)) {
+		case conf_parser::parse_skip_space_before_equal:
+			if (conf_cc(c) & CONF_CC_SPACE) {
 				if (c == '\n') line++;
 				continue;
 			}
 			if (c == '=') {
-				mode = parse_skip_space_after_equal;
+				mode = conf_parser::parse_skip_space_after_equal;
 			}
 		break; // parse_skip_space_before_equal
 
-		case parse_skip_space_after_equal:
-			if (isspace(c)) { if (c == '\n') line++; continue; }
-			if (c == '\'') { mode = parse_value_in_single_quote; value_fill = 0; continue; }
-			if (c == '"') { mode = parse_value_in_double_quote; value_fill = 0; continue; }
+		case conf_parser::parse_skip_space_after_equal:
+			if (conf_cc(c) & CONF_CC_SPACE) { if (c == '\n') line++; continue; }
+			if (c == '\'') { mode = conf_parser::parse_value_in_single_quote; value_begin = p + 1; continue; }
+			if (c == '"') { mode = conf_parser::parse_value_in_double_quote; value_begin = p + 1; continue; }
 			if (c == '#') { // empty param value (comment line)
-				value_fill = 0;
-				param_value[value_fill] = 0;
-				ret->insert(std::make_pair(param_name,param_value));
-				mode = parse_skip_comment_line;
+				err = conf_emit_option(st, sink, std::string_view(name_begin, name_end - name_begin), std::string_view());
+				if (err) goto stop;
+				mode = conf_parser::parse_skip_comment_line;
 				continue;
 			}
-			param_value[0] = c;
-			value_fill = 1;
-			mode = parse_value;
+			value_begin = p;
+			mode = conf_parser::parse_value;
 		break; // parse_skip_space_after_equal
 
-		case parse_value:
-			if (isspace(c) || c == '#') {
-				mode = parse_line_end;
-				if (c == '#') mode = parse_skip_comment_line;
-				param_value[value_fill] = 0;
-				value_fill++;
-				ret->insert(std::make_pair(param_name,param_value));
-				if (c == '\n') { line++; mode = parse_skip_space; }
+		case conf_parser::parse_value:
+			if (conf_cc(c) & CONF_CC_VALUE_END) {
+				mode = conf_parser::parse_line_end;
+				if (c == '#') mode = conf_parser::parse_skip_comment_line;
+				err = conf_emit_option(st, sink, std::string_view(name_begin, name_end - name_begin),
+					std::string_view(value_begin, p - value_begin));
+				if (err) goto stop;
+				if (c == '\n') { line++; mode = conf_parser::parse_skip_space; }
 				continue;
 			}
-			param_value[value_fill] = c;
-			if (value_fill + 1 > CONF_PARAM_VALUE_MAX_LEN - 1) {
-				std::cerr << "Error in " << file_name << ": value length is very big on " << line << " line" << std::endl;
-				fconf.close(); ret->clear();
-				return CONFERR_WRONGVALUE;
-			}
-			value_fill++;
+			p = scan.value_end(p, end) - 1; // skip to the last value byte
 		break; // parse_value
 
-		case parse_line_end:
-			if (isspace(c)) {
-				if (c == '\n') { line++; mode = parse_skip_space; }
+		case conf_parser::parse_line_end:
+			if (conf_cc(c) & CONF_CC_SPACE) {
+				if (c == '\n') { line++; mode = conf_parser::parse_skip_space; }
 				continue;
 			}
 			if (c == '#') {
-				mode = parse_skip_comment_line;
+				mode = conf_parser::parse_skip_comment_line;
 				continue;
 			}
-			std::cerr << "Error in " << file_name
-				<< ": wrong char '" << c
-				<< "' on " << line << " line" << std::endl;
-			fconf.close(); ret->clear();
-			return CONFERR_WRONGSYNTAX;
+			err = conf_report(st, CONFERR_WRONGSYNTAX, "wrong char after value",
+				block_begin, p, line, file_name);
+			if (!st->recover) return err;
+			goto skip_line;
 		break; // parse_line_end
 
-		case parse_value_in_single_quote:
+		case conf_parser::parse_value_in_single_quote:
 			if (c != '\'' ){
 				if (c == '\n') line++;
-				param_value[value_fill] = c;
-				if (value_fill + 1 > CONF_PARAM_VALUE_MAX_LEN - 1) {
-					std::cerr << "Error in " << file_name
-						<< ": value length is very big on"
-						<< line << " line" << std::endl;
-					fconf.close(); ret->clear();
-					return CONFERR_WRONGVALUE;
-				}
-				value_fill++;
+				else p = scan.quote(p, end, '\'') - 1; // skip to the last byte before quote or new line
 				continue;
 			}
-			param_value[value_fill] = 0;
-			value_fill++;
-			ret->insert(std::make_pair(param_name, param_value));
-			mode = parse_skip_space;
+			err = conf_emit_option(st, sink, std::string_view(name_begin, name_end - name_begin),
+				std::string_view(value_begin, p - value_begin));
+			if (err) goto stop;
+			mode = conf_parser::parse_skip_space;
 		break; // parse_value_in_single_quote
 
-		case parse_value_in_double_quote:
+		case conf_parser::parse_value_in_double_quote:
 			if (c != '\"' ){
 				if (c == '\n') line++;
-				param_value[value_fill] = c;
-				if (value_fill + 1 > CONF_PARAM_VALUE_MAX_LEN - 1) {
-					std::cerr << "Error in " << file_name
-						<< ": value length is very big on "
-						<< line << " line" << std::endl;
-					fconf.close(); ret->clear();
-					return CONFERR_WRONGVALUE;
-				}
-				value_fill++;
+				else p = scan.quote(p, end, '"') - 1; // skip to the last byte before quote or new line
 				continue;
 			}
-			param_value[value_fill] = 0;
-			value_fill++;
-			ret->insert(std::make_pair(param_name, param_value));
-			mode = parse_skip_space;
+			err = conf_emit_option(st, sink, std::string_view(name_begin, name_end - name_begin),
+				std::string_view(value_begin, p - value_begin));
+			if (err) goto stop;
+			mode = conf_parser::parse_skip_space;
 		break; // parse_value_in_double_quote
 
+		case conf_parser::parse_section:
+			if (c == ']') {
+				const char *section_begin = name_begin + 1;
+				const char *section_end = p;
+				const char *bad = conf_section_name_error(&section_begin, &section_end);
+				if (bad) {
+					err = conf_report(st, CONFERR_WRONGPARAM, "wrong section name",
+						block_begin, bad, line, file_name);
+					if (!st->recover) return err;
+					goto skip_line;
+				}
+				st->section.assign(section_begin, section_end - section_begin);
+				mode = conf_parser::parse_line_end;
+				continue;
+			}
+			if (c == '\n') {
+				err = conf_report(st, CONFERR_WRONGSYNTAX, "no ']' at end of section",
+					block_begin, name_begin, line, file_name);
+				if (!st->recover) return err;
+				goto skip_line;
+			}
+		break; // parse_section
+
 		} // switch
-	} // while read conf
+		continue;
+
+	skip_line: // recover mode: rest of line with error is skipped like comment
+		if (!st->first_error) st->first_error = err;
+		st->errors++;
+		err = 0;
+		if (c == '\n') { line++; mode = conf_parser::parse_skip_space; }
+		else mode = conf_parser::parse_skip_comment_line;
+	} // for block bytes
+
+	// offsets for error reports of next blocks
+	for (const char *q = end; q > block_begin; q--) {
+		if (q[-1] == '\n') { st->line_offset = st->offset + (q - block_begin); break; }
+	}
+	st->offset += end - block_begin;
+
+stop:
+	st->mode = mode;
+	st->line = line;
+	st->name_begin = name_begin;
+	st->name_end = name_end;
+	st->value_begin = value_begin;
+
+	return err;
+} // conf_parse_block()
+
+// Finish parsing at end of input end: pass to sink option which value
+// ends without new line (unquoted value or unclosed quotes)
+template <class Sink>
+inline int conf_parse_finish(conf_parser *st, const char *end, Sink &sink) {
+	int err = 0;
+	switch (st->mode) {
+	case conf_parser::parse_value:
+	case conf_parser::parse_value_in_single_quote:
+	case conf_parser::parse_value_in_double_quote:
+		err = conf_emit_option(st, sink, std::string_view(st->name_begin, st->name_end - st->name_begin),
+			std::string_view(st->value_begin, end - st->value_begin));
+	break;
+	default:
+	break;
+	}
+	st->mode = conf_parser::parse_skip_space;
+	return err;
+} // conf_parse_finish()
+
+// Sink for conf_parse_block() which copies options into unordered_map,
+// first option with the same name wins
+struct conf_map_sink {
+	std::unordered_map<std::string,std::string> *ret;
+
+	void operator()(std::string_view name, std::string_view value) {
+		ret->emplace(name, value);
+	}
+};
+
+// Parse whole buffer [data, data + size) to sink, flags are CONF_PARSE_*
+// return 0 on success or some error code (the first one)
+template <class Sink>
+inline int conf_parse_all(const char *data, size_t size, const std::string &file_name, Sink &sink,
+	unsigned flags = 0)
+{
+	conf_parser st;
+	st.set_flags(flags);
+	int err = conf_parse_block(&st, data, data + size, file_name, sink);
+	if (err) return err;
+	err = conf_parse_finish(&st, data + size, sink);
+	return err ? err : st.first_error;
+} // conf_parse_all()
+
+// Parse config file file_name to sink reading it by blocks, flags are
+// CONF_PARSE_*
+// return 0 on success or some error code (the first one)
+template <class Sink>
+inline int conf_parse_file(const std::string &file_name, Sink &sink, unsigned flags = 0) {
+	std::ifstream fconf(file_name, std::ios::binary);
+	if (!fconf) return CONFERR_ERRFILE;
+
+	// read file by big blocks instead of get() per char, bytes of
+	// unfinished option are moved to the block begin before next read
+	std::vector<char> block(CONF_READ_BLOCK_SIZE);
+	size_t kept = 0;
+	conf_parser st;
+	st.set_flags(flags);
+	int err;
 
-	return 0; // success
+	while (fconf) {
+		if (block.size() - kept < CONF_READ_BLOCK_SIZE / 2) {
+			// pending bytes are at block begin, old block is alive until
+			// pointers are moved into new one
+			std::vector<char> bigger(block.size() * 2);
+			std::memcpy(bigger.data(), block.data(), kept);
+			st.rebase(block.data(), bigger.data());
+			block.swap(bigger);
+		}
+		fconf.read(block.data() + kept, block.size() - kept);
+		std::streamsize got = fconf.gcount();
+		if (got <= 0) break;
+
+		const char *end = block.data() + kept + got;
+		err = conf_parse_block(&st, block.data() + kept, end, file_name, sink);
+		if (err) return err;
+
+		const char *pending = st.pending();
+		kept = pending ? end - pending : 0;
+		if (kept) {
+			std::memmove(block.data(), pending, kept);
+			st.rebase(pending, block.data());
+		}
+	}
+
+	err = conf_parse_finish(&st, block.data() + kept, sink);
+	return err ? err : st.first_error;
+} // conf_parse_file()
+
+// Parse config file file_name and fill the unordered_map of strings "option"=>"value"
+// return 0 on success or some error code
+inline int parse_config(std::string file_name, std::unordered_map<std::string,std::string> *ret) {
+	if (!ret) return CONFERR_NORET;
+
+	conf_map_sink sink = { ret };
+	int err = conf_parse_file(file_name, sink);
+	if (err) ret->clear();
+	return err;
 } // parse_config()
 
+#ifdef CONF_HAVE_MMAP
+// Whole file mapped read-only, addr is nullptr for empty file
+struct conf_mapping {
+	void *addr = nullptr;
+	size_t size = 0;
+};
 
-/*
-#include <vector>
-// Example of usage
-int main() {
+// Map file file_name into memory read-only with madvise() advice,
+// free with munmap(m.addr, m.size) when m.addr is not nullptr
+// return 0 on success or some error code
+inline int conf_map_file(const std::string &file_name, conf_mapping *m, int advice) {
+	*m = conf_mapping();
+	int fd = open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) return CONFERR_ERRFILE;
 
-	std::string config_file_name  = "test.conf";
+	struct stat sb;
+	if (fstat(fd, &sb) != 0) { close(fd); return CONFERR_ERRFILE; }
+
+	size_t size = sb.st_size;
+	if (size == 0) { close(fd); return 0; }
+
+	void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // mapping keeps the file referenced
+	if (map == MAP_FAILED) return CONFERR_ERRFILE;
+	madvise(map, size, advice);
+
+	m->addr = map;
+	m->size = size;
+	return 0;
+} // conf_map_file()
+
+// Parse config file file_name mapped into memory read-only, state machine
+// runs straight over the mapped pages without copying to a read buffer
+// return 0 on success or some error code
+inline int parse_config_mmap(std::string file_name, std::unordered_map<std::string,std::string> *ret) {
+	if (!ret) return CONFERR_NORET;
+
+	conf_mapping m;
+	int err = conf_map_file(file_name, &m, MADV_SEQUENTIAL);
+	if (err || !m.addr) return err;
+
+	conf_map_sink sink = { ret };
+	err = conf_parse_all(static_cast<const char *>(m.addr), m.size, file_name, sink);
+	if (err) ret->clear();
+
+	munmap(m.addr, m.size);
+	return err;
+} // parse_config_mmap()
+#endif /* CONF_HAVE_MMAP */
+
+// Parse config from memory buffer [data, data + size) and fill the
+// unordered_map of strings "option"=>"value", no file is involved
+// return 0 on success or some error code
+inline int parse_config_buffer(const char *data, size_t size, std::unordered_map<std::string,std::string> *ret) {
+	if (!ret) return CONFERR_NORET;
+	if (!data && size) return CONFERR_ERRFILE;
+
+	conf_map_sink sink = { ret };
+	int err = conf_parse_all(data, size, conf_buffer_name, sink);
+	if (err) ret->clear();
+	return err;
+} // parse_config_buffer()
+
+inline int parse_config_buffer(std::string_view buf, std::unordered_map<std::string,std::string> *ret) {
+	return parse_config_buffer(buf.data(), buf.size(), ret);
+} // parse_config_buffer()
+
+// Sink which drops options, parser only checks syntax
+struct conf_null_sink {
+	void operator()(std::string_view, std::string_view) {}
+};
+
+// Error handler which appends errors to vector, installed for calling
+// thread while object lives (nullptr vector - handler of thread is kept).
+// file_name of collected errors is empty: it is valid only during call
+// of handler, all errors are of the file being parsed.
+class conf_error_collector {
+public:
+	explicit conf_error_collector(std::vector<conf_error> *errors) : errors(errors) {
+		if (!errors) return;
+		saved = conf_thread_error_handler();
+		conf_on_error(collect, errors);
+	}
+	conf_error_collector(const conf_error_collector &) = delete;
+	conf_error_collector &operator=(const conf_error_collector &) = delete;
+	~conf_error_collector() {
+		if (errors) conf_thread_error_handler() = saved;
+	}
+
+private:
+	std::vector<conf_error> *errors;
+	conf_error_handler saved;
+
+	static void collect(const conf_error &err, void *arg) {
+		std::vector<conf_error> *v = static_cast<std::vector<conf_error> *>(arg);
+		v->push_back(err);
+		v->back().file_name = std::string_view();
+	}
+};
+
+// Parse config file file_name like parse_config() but don't stop at
+// syntax error: line with error is skipped and parsing goes on from next
+// line, so one pass finds all errors. Errors are appended to *errors
+// (nullptr - passed to error handler of thread), options of good lines
+// are kept in *ret.
+// return 0 if config has no errors or code of the first error
+inline int parse_config_collect(std::string file_name, std::unordered_map<std::string,std::string> *ret,
+	std::vector<conf_error> *errors)
+{
+	if (!ret) return CONFERR_NORET;
+
+	conf_error_collector collector(errors);
+	conf_map_sink sink = { ret };
+	return conf_parse_file(file_name, sink, CONF_PARSE_RECOVER);
+} // parse_config_collect()
+
+// Check syntax of config file file_name without building any values,
+// all errors are appended to *errors (nullptr - passed to error handler
+// of thread) like in parse_config_collect()
+// return 0 if config has no errors or code of the first error
+inline int conf_validate(std::string file_name, std::vector<conf_error> *errors) {
+	conf_error_collector collector(errors);
+	conf_null_sink sink;
+	return conf_parse_file(file_name, sink, CONF_PARSE_RECOVER);
+} // conf_validate()
+
+// Check syntax of config in memory [data, data + size), see conf_validate()
+// return 0 if config has no errors or code of the first error
+inline int conf_validate_buffer(const char *data, size_t size, std::vector<conf_error> *errors) {
+	if (!data && size) return CONFERR_ERRFILE;
+
+	conf_error_collector collector(errors);
+	conf_null_sink sink;
+	return conf_parse_all(data, size, conf_buffer_name, sink, CONF_PARSE_RECOVER);
+} // conf_validate_buffer()
+
+// Hash of option name, used by view, flat and cached containers. Reads key
+// 8 bytes at a time (tail with overlapped or split loads, no byte loop)
+// and result never is 0, so 0 can mark empty hash table slot.
+inline uint64_t conf_hash(std::string_view s) {
+	const uint64_t k = 0x9E3779B97F4A7C15ull;
+	const unsigned char *p = reinterpret_cast<const unsigned char *>(s.data());
+	size_t n = s.size();
+	uint64_t h = n * k;
+	uint64_t w;
+	uint32_t lo, hi;
+
+	if (n >= 8) {
+		const unsigned char *last = p + n - 8;
+		for (; p < last; p += 8) {
+			std::memcpy(&w, p, 8);
+			h = (h ^ w) * k;
+		}
+		std::memcpy(&w, last, 8);
+		h = (h ^ w) * k;
+	} else if (n >= 4) {
+		std::memcpy(&lo, p, 4);
+		std::memcpy(&hi, p + n - 4, 4);
+		h = (h ^ (lo | (uint64_t)hi << 32)) * k;
+	} else if (n) {
+		h = (h ^ (p[0] | (uint64_t)p[n / 2] << 8 | (uint64_t)p[n - 1] << 16)) * k;
+	}
+
+	h ^= h >> 29;
+	h *= 0xD6E8FEB86659FD93ull;
+	h ^= h >> 32;
+	return h ? h : 1;
+} // conf_hash()
+
+// Result of zero-copy parsing: keys and values are std::string_view
+// pointing into input buffer, which is owned (or mapped) by this object
+// and released together with it. Options are kept in one array of
+// offset pairs into input and found through open addressing table of
+// 8 byte slots (hash tag and option index), so there is no allocation
+// per option, only growth of the two arrays.
+class conf_view {
+public:
+	conf_view() {}
+	conf_view(const conf_view &) = delete;
+	conf_view &operator=(const conf_view &) = delete;
+	conf_view(conf_view &&other) { *this = std::move(other); }
+	conf_view &operator=(conf_view &&other) {
+		if (this != &other) {
+			release();
+			base = other.base;
+			entries = std::move(other.entries);
+			slots = std::move(other.slots);
+			owned = std::move(other.owned);
+			map_addr = other.map_addr; map_size = other.map_size;
+			other.map_addr = nullptr; other.map_size = 0;
+			other.release();
+		}
+		return *this;
+	}
+	~conf_view() { release(); }
+
+	// find option key, return true and its value in *value if found
+	bool find(std::string_view key, std::string_view *value = nullptr) const {
+		if (slots.empty()) return false;
+		uint64_t s = slots[probe(key, conf_hash(key))];
+		if (!s) return false;
+		if (value) *value = this->value(static_cast<uint32_t>(s) - 1);
+		return true;
+	}
+
+	// value of option key or def if not found
+	std::string_view get(std::string_view key, std::string_view def = std::string_view()) const {
+		std::string_view v;
+		return find(key, &v) ? v : def;
+	}
+
+	// options in file order: key(i), value(i) for i < size()
+	size_t size() const { return entries.size(); }
+	std::string_view key(size_t i) const {
+		return std::string_view(base + entries[i].key_off, entries[i].key_len);
+	}
+	std::string_view value(size_t i) const {
+		return std::string_view(base + entries[i].value_off, entries[i].value_len);
+	}
+
+	// free input buffer and all views into it
+	void release() {
+		base = nullptr;
+		entries.clear();
+		slots.clear();
+		owned.reset();
+#ifdef CONF_HAVE_MMAP
+		if (map_addr) munmap(map_addr, map_size);
+#endif
+		map_addr = nullptr; map_size = 0;
+	}
+
+private:
+	// option as offsets from input begin
+	struct entry {
+		uint64_t key_off;
+		uint64_t value_off;
+		uint32_t key_len;
+		uint32_t value_len;
+	};
+
+	const char *base = nullptr; // input begin
+	std::vector<entry> entries; // in file order
+	std::vector<uint64_t> slots; // tag << 32 | (entry index + 1), 0 - empty
+	// input read into memory, string is kept on heap so its bytes (even
+	// short ones in the string object itself) don't move with conf_view
+	std::unique_ptr<std::string> owned;
+	void *map_addr = nullptr;
+	size_t map_size = 0;
+
+	static uint64_t tag_of(uint64_t h) {
+		uint64_t tag = h >> 32;
+		return (tag ? tag : 1) << 32;
+	}
+
+	// slot of key or first empty slot on its probe chain
+	size_t probe(std::string_view key, uint64_t h) const {
+		size_t mask = slots.size() - 1;
+		uint64_t tag = tag_of(h);
+		for (size_t i = h & mask; ; i = (i + 1) & mask) {
+			uint64_t s = slots[i];
+			if (!s) return i;
+			if ((s & 0xFFFFFFFF00000000ull) == tag && this->key(static_cast<uint32_t>(s) - 1) == key)
+				return i;
+		}
+	}
+
+	void rehash(size_t cap) {
+		slots.assign(cap, 0);
+		size_t mask = cap - 1;
+		for (size_t n = 0; n < entries.size(); n++) {
+			uint64_t h = conf_hash(key(n));
+			size_t i = h & mask;
+			while (slots[i]) i = (i + 1) & mask;
+			slots[i] = tag_of(h) | (n + 1);
+		}
+	}
+
+	// add option which lies in input, first option with the same name wins
+	void insert(std::string_view key, std::string_view value) {
+		if ((entries.size() + 1) * 2 > slots.size())
+			rehash(slots.empty() ? 16 : slots.size() * 2);
+		uint64_t h = conf_hash(key);
+		size_t i = probe(key, h);
+		if (slots[i]) return;
+		entries.push_back({ static_cast<uint64_t>(key.data() - base), static_cast<uint64_t>(value.data() - base),
+			static_cast<uint32_t>(key.size()), static_cast<uint32_t>(value.size()) });
+		slots[i] = tag_of(h) | entries.size();
+	}
+
+	friend struct conf_view_sink;
+	friend int parse_config_view(std::string file_name, conf_view *ret);
+	friend int parse_config_view_buffer(std::string data, conf_view *ret);
+	friend int conf_view_fill(conf_view *ret, const char *data, size_t size, const std::string &file_name);
+};
+
+// Sink for conf_parse_block() which stores options of conf_view
+struct conf_view_sink {
+	conf_view *ret;
+
+	void operator()(std::string_view name, std::string_view value) {
+		ret->insert(name, value);
+	}
+};
+
+inline int conf_view_fill(conf_view *ret, const char *data, size_t size, const std::string &file_name) {
+	ret->base = data;
+	conf_view_sink sink = { ret };
+	int err = conf_parse_all(data, size, file_name, sink);
+	if (err) ret->release();
+	return err;
+} // conf_view_fill()
+
+// Parse config file file_name into conf_view without copying any key or
+// value, file is mapped (or read once) and kept while ret is alive
+// return 0 on success or some error code
+inline int parse_config_view(std::string file_name, conf_view *ret) {
+	if (!ret) return CONFERR_NORET;
+	ret->release();
+
+#ifdef CONF_HAVE_MMAP
+	conf_mapping m;
+	int err = conf_map_file(file_name, &m, MADV_SEQUENTIAL);
+	if (err || !m.addr) return err;
+
+	ret->map_addr = m.addr;
+	ret->map_size = m.size;
+	return conf_view_fill(ret, static_cast<const char *>(m.addr), m.size, file_name);
+#else
+	std::ifstream fconf(file_name, std::ios::binary);
+	if (!fconf) return CONFERR_ERRFILE;
+	ret->owned.reset(new std::string(std::istreambuf_iterator<char>(fconf), std::istreambuf_iterator<char>()));
+	return conf_view_fill(ret, ret->owned->data(), ret->owned->size(), file_name);
+#endif
+} // parse_config_view()
+
+// Parse config from data into conf_view, data is moved into ret and
+// all keys and values point into it
+// return 0 on success or some error code
+inline int parse_config_view_buffer(std::string data, conf_view *ret) {
+	if (!ret) return CONFERR_NORET;
+	ret->release();
+
+	ret->owned.reset(new std::string(std::move(data)));
+	return conf_view_fill(ret, ret->owned->data(), ret->owned->size(), conf_buffer_name);
+} // parse_config_view_buffer()
+
+// Config generation allocated in arena: hash map nodes, buckets, keys and
+// values all come from std::pmr::monotonic_buffer_resource, so whole
+// config lives in a few contiguous blocks. Map destructor is never run,
+// its memory is dropped with the arena blocks in O(1) on clear() or when
+// object is destroyed.
+class conf_arena {
+public:
+	typedef std::pmr::unordered_map<std::pmr::string, std::pmr::string> map_type;
+
+	// size_hint - expected bytes of keys and values (e.g. file size)
+	explicit conf_arena(size_t size_hint = 0)
+		: arena(size_hint * 2 > CONF_ARENA_BLOCK_SIZE ? size_hint * 2 : CONF_ARENA_BLOCK_SIZE)
+	{
+		new (storage) map_type(&arena);
+	}
+	conf_arena(const conf_arena &) = delete;
+	conf_arena &operator=(const conf_arena &) = delete;
+	~conf_arena() { arena.release(); }
+
+	map_type &values() { return *std::launder(reinterpret_cast<map_type *>(storage)); }
+	const map_type &values() const { return *std::launder(reinterpret_cast<const map_type *>(storage)); }
+
+	// drop all options and arena blocks in O(1)
+	void clear() {
+		arena.release();
+		new (storage) map_type(&arena);
+	}
 
-	// define variables for store options from config file
-	// set default values for all options
-	std::string mysql_host = "127.0.0.1";
-	std::string mysql_user = "root";
-	std::string mysql_password = "strongrootpassword";
-	std::string mysql_database = "database";
-
-	// make list of known options and variables for program
-	struct config_options_st {
-		std::string name;
-		std::string *var_ptr;
+private:
+	std::pmr::monotonic_buffer_resource arena;
+	alignas(map_type) unsigned char storage[sizeof(map_type)];
+};
+
+// Sink for conf_parse_block() which copies options into conf_arena
+struct conf_arena_sink {
+	conf_arena::map_type *ret;
+
+	void operator()(std::string_view name, std::string_view value) {
+		ret->emplace(name, value);
+	}
+};
+
+// Parse config file file_name into arena allocated map
+// return 0 on success or some error code
+inline int parse_config_arena(std::string file_name, conf_arena *ret) {
+	if (!ret) return CONFERR_NORET;
+	ret->clear();
+
+	conf_arena_sink sink = { &ret->values() };
+	int err = conf_parse_file(file_name, sink);
+	if (err) ret->clear();
+	return err;
+} // parse_config_arena()
+
+// Parse config from memory buffer [data, data + size) into arena allocated map
+// return 0 on success or some error code
+inline int parse_config_arena_buffer(const char *data, size_t size, conf_arena *ret) {
+	if (!ret) return CONFERR_NORET;
+	if (!data && size) return CONFERR_ERRFILE;
+	ret->clear();
+
+	conf_arena_sink sink = { &ret->values() };
+	int err = conf_parse_all(data, size, conf_buffer_name, sink);
+	if (err) ret->clear();
+	return err;
+} // parse_config_arena_buffer()
+
+// Flat read-only lookup table of options: all keys and values are kept in
+// one string table as records [value length][key][value] and 16 byte open
+// addressing slots hold hash tag, key length and record offset, so lookup
+// is one hash, one slot read and one record read instead of node chasing.
+// Table is built once by insert() (first option with the same name wins)
+// and then only read.
+class conf_flat_map {
+public:
+	conf_flat_map() {}
+
+	// build from any map of string-like key/value pairs
+	template <class Map>
+	explicit conf_flat_map(const Map &m) {
+		reserve(m.size());
+		for (const auto &kv : m) insert(kv.first, kv.second);
+	}
+
+	void reserve(size_t count) {
+		entries.reserve(count);
+		size_t cap = 16;
+		while (cap < count * 2) cap <<= 1;
+		if (cap > slots.size()) rehash(cap);
+	}
+
+	// add option, return false if option with this name already exists
+	bool insert(std::string_view key, std::string_view value) {
+		if ((entries.size() + 1) * 2 > slots.size())
+			rehash(slots.empty() ? 16 : slots.size() * 2);
+
+		uint64_t h = conf_hash(key);
+		size_t i = probe(key, h);
+		if (slots[i].tag) return false;
+
+		slot &s = slots[i];
+		s.tag = tag_of(h);
+		s.key_len = key.size();
+		s.off = strings.size();
+		uint32_t value_len = value.size();
+		strings.append(reinterpret_cast<const char *>(&value_len), sizeof(value_len));
+		strings.append(key);
+		strings.append(value);
+		entries.push_back(i);
+		return true;
+	}
+
+	// find option key, return true and its value in *value if found
+	bool find(std::string_view key, std::string_view *value = nullptr) const {
+		if (slots.empty()) return false;
+		const slot &s = slots[probe(key, conf_hash(key))];
+		if (!s.tag) return false;
+		if (value) *value = value_of(s);
+		return true;
+	}
+
+	// value of option key or def if not found
+	std::string_view get(std::string_view key, std::string_view def = std::string_view()) const {
+		std::string_view v;
+		return find(key, &v) ? v : def;
+	}
+
+	// options in insertion order: key(i), value(i) for i < size()
+	size_t size() const { return entries.size(); }
+	std::string_view key(size_t i) const {
+		const slot &s = slots[entries[i]];
+		return std::string_view(strings.data() + s.off + sizeof(uint32_t), s.key_len);
+	}
+	std::string_view value(size_t i) const { return value_of(slots[entries[i]]); }
+
+	void clear() { strings.clear(); entries.clear(); slots.clear(); }
+
+private:
+	struct slot {
+		uint32_t tag; // high bits of hash, 0 for empty slot
+		uint32_t key_len;
+		uint64_t off; // record offset in strings
 	};
 
-	std::vector<struct config_options_st> conf_params = {
-		{"host", &mysql_host}
-		,{"user", &mysql_user}
-		,{"password", &mysql_password}
-		,{"database", &mysql_database}
+	std::string strings;
+	std::vector<size_t> entries; // slots in insertion order
+	std::vector<slot> slots; // power of two size
+
+	static uint32_t tag_of(uint64_t h) {
+		uint32_t tag = h >> 32;
+		return tag ? tag : 1;
+	}
+
+	std::string_view value_of(const slot &s) const {
+		uint32_t value_len;
+		std::memcpy(&value_len, strings.data() + s.off, sizeof(value_len));
+		return std::string_view(strings.data() + s.off + sizeof(uint32_t) + s.key_len, value_len);
+	}
+
+	// slot of key or first empty slot on its probe chain
+	size_t probe(std::string_view key, uint64_t h) const {
+		size_t mask = slots.size() - 1;
+		uint32_t tag = tag_of(h);
+		for (size_t i = h & mask; ; i = (i + 1) & mask) {
+			const slot &s = slots[i];
+			if (!s.tag) return i;
+			if (s.tag == tag && s.key_len == key.size()
+				&& std::memcmp(strings.data() + s.off + sizeof(uint32_t), key.data(), key.size()) == 0)
+				return i;
+		}
+	}
+
+	void rehash(size_t cap) {
+		std::vector<slot> old(cap);
+		slots.swap(old);
+		size_t mask = cap - 1;
+		for (size_t n = 0; n < entries.size(); n++) {
+			const slot &s = old[entries[n]];
+			// slot keeps only high bits of hash, so take it again from key
+			uint64_t h = conf_hash(std::string_view(strings.data() + s.off + sizeof(uint32_t), s.key_len));
+			size_t i = h & mask;
+			while (slots[i].tag) i = (i + 1) & mask;
+			slots[i] = s;
+			entries[n] = i;
+		}
+	}
+};
+
+// Sink for conf_parse_block() which builds conf_flat_map
+struct conf_flat_sink {
+	conf_flat_map *ret;
+
+	void operator()(std::string_view name, std::string_view value) {
+		ret->insert(name, value);
+	}
+};
+
+// Parse config file file_name straight into flat lookup table
+// return 0 on success or some error code
+inline int parse_config_flat(std::string file_name, conf_flat_map *ret) {
+	if (!ret) return CONFERR_NORET;
+	ret->clear();
+
+	conf_flat_sink sink = { ret };
+	int err = conf_parse_file(file_name, sink);
+	if (err) ret->clear();
+	return err;
+} // parse_config_flat()
+
+// Parse config from memory buffer [data, data + size) into flat lookup table
+// return 0 on success or some error code
+inline int parse_config_flat_buffer(const char *data, size_t size, conf_flat_map *ret) {
+	if (!ret) return CONFERR_NORET;
+	if (!data && size) return CONFERR_ERRFILE;
+	ret->clear();
+
+	conf_flat_sink sink = { ret };
+	int err = conf_parse_all(data, size, conf_buffer_name, sink);
+	if (err) ret->clear();
+	return err;
+} // parse_config_flat_buffer()
+
+// Byte by byte hash usable in constant expressions (FNV-1a 64 bit)
+constexpr uint64_t conf_hash_const(std::string_view s) {
+	uint64_t h = 14695981039346656037ull;
+	for (char c : s) {
+		h ^= static_cast<unsigned char>(c);
+		h *= 1099511628211ull;
+	}
+	return h;
+}
+
+constexpr uint64_t conf_hash_mix(uint64_t h) {
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDull;
+	h ^= h >> 33;
+	return h;
+}
+
+constexpr size_t conf_pow2_at_least(size_t n) {
+	size_t p = 1;
+	while (p < n) p <<= 1;
+	return p;
+}
+
+// Registry of known option names with perfect hash built at compile time
+// (hash and displace: names are spread to buckets by one hash, every
+// bucket gets own seed which puts all its names to free slots).
+// index() maps name to its position in the list with one pass over name
+// bytes, one table read and one compare to reject unknown names.
+// Usage:
+//   static constexpr std::string_view names[] = { "host", "user" };
+//   static constexpr conf_key_registry known(names);
+//   int i = known.index("user"); // 1, or -1 for unknown name
+template <size_t N>
+class conf_key_registry {
+public:
+	static constexpr size_t table_size = conf_pow2_at_least(N * 2);
+	static constexpr size_t bucket_count = N / 2 + 1;
+
+	constexpr explicit conf_key_registry(const std::string_view (&list)[N])
+		: conf_key_registry(&list[0], 0) {}
+	constexpr explicit conf_key_registry(const std::array<std::string_view, N> &list)
+		: conf_key_registry(list.data(), 0) {}
+
+	// position of name key in the list or -1 for unknown name
+	constexpr int index(std::string_view key) const {
+		uint64_t h = conf_hash_const(key);
+		size_t i = table[slot(h, seeds[bucket(h)])];
+		if (!i || names[i - 1] != key) return -1;
+		return i - 1;
+	}
+
+	static constexpr size_t size() { return N; }
+	constexpr std::string_view name(size_t i) const { return names[i]; }
+
+private:
+	std::string_view names[N];
+	uint64_t seeds[bucket_count];
+	size_t table[table_size]; // name position + 1, 0 for empty slot
+
+	constexpr conf_key_registry(const std::string_view *list, int)
+		: names(), seeds(), table()
+	{
+		uint64_t hash[N] = {};
+		size_t bucket_of[N] = {};
+		size_t first[bucket_count + 1] = {}; // names of bucket b: member[first[b] .. first[b + 1])
+		size_t member[N] = {};
+		bool used[table_size] = {};
+
+		for (size_t i = 0; i < N; i++) {
+			names[i] = list[i];
+			hash[i] = conf_hash_const(list[i]);
+			for (size_t j = 0; j < i; j++)
+				if (hash[j] == hash[i] && names[j] == names[i])
+					throw "conf_key_registry: duplicate option name";
+			bucket_of[i] = bucket(hash[i]);
+			first[bucket_of[i] + 1]++;
+		}
+		size_t max_size = 0;
+		for (size_t b = 0; b < bucket_count; b++) {
+			if (first[b + 1] > max_size) max_size = first[b + 1];
+			first[b + 1] += first[b];
+		}
+		size_t fill[bucket_count] = {};
+		for (size_t i = 0; i < N; i++)
+			member[first[bucket_of[i]] + fill[bucket_of[i]]++] = i;
+
+		// place big buckets first, while table is still empty
+		size_t taken[N] = {};
+		for (size_t size = max_size; size > 0; size--) {
+			for (size_t b = 0; b < bucket_count; b++) {
+				if (first[b + 1] - first[b] != size) continue;
+
+				for (uint64_t seed = 1; ; seed++) {
+					if (seed > 1000000) throw "conf_key_registry: can't build perfect hash";
+					bool ok = true;
+					for (size_t n = 0; n < size && ok; n++) {
+						size_t s = slot(hash[member[first[b] + n]], seed);
+						if (used[s]) ok = false;
+						for (size_t k = 0; k < n && ok; k++)
+							if (taken[k] == s) ok = false;
+						taken[n] = s;
+					}
+					if (!ok) continue;
+
+					for (size_t n = 0; n < size; n++) {
+						used[taken[n]] = true;
+						table[taken[n]] = member[first[b] + n] + 1;
+					}
+					seeds[b] = seed;
+					break;
+				}
+			}
+		}
+	}
+
+	static constexpr size_t bucket(uint64_t h) {
+		return (conf_hash_mix(h) >> 32) % bucket_count;
+	}
+	static constexpr size_t slot(uint64_t h, uint64_t seed) {
+		return conf_hash_mix(h ^ (seed * 0x9E3779B97F4A7C15ull)) & (table_size - 1);
+	}
+};
+
+// Sink for conf_parse_block() which binds option to known name position
+// while scanning, fn(size_t index, std::string_view value) is called for
+// known name, parsing is stopped with CONFERR_WRONGPARAM on unknown name
+template <size_t N, class Fn>
+struct conf_registry_sink {
+	const conf_key_registry<N> *reg;
+	Fn *fn;
+	std::string *unknown;
+
+	int operator()(std::string_view name, std::string_view value) {
+		int i = reg->index(name);
+		if (i < 0) {
+			if (unknown) unknown->assign(name);
+			return CONFERR_WRONGPARAM;
+		}
+		(*fn)(static_cast<size_t>(i), value);
+		return 0;
+	}
+};
+
+// Parse config file file_name and pass every option to
+// fn(size_t index, std::string_view value) by its position in reg,
+// name of unknown option is stored to *unknown if given
+// return 0 on success or some error code
+template <size_t N, class Fn>
+inline int parse_config_known(std::string file_name, const conf_key_registry<N> &reg,
+	Fn fn, std::string *unknown = nullptr)
+{
+	conf_registry_sink<N, Fn> sink = { &reg, &fn, unknown };
+	return conf_parse_file(file_name, sink);
+} // parse_config_known()
+
+// Same as parse_config_known() for config in memory buffer [data, data + size)
+template <size_t N, class Fn>
+inline int parse_config_known_buffer(const char *data, size_t size, const conf_key_registry<N> &reg,
+	Fn fn, std::string *unknown = nullptr)
+{
+	if (!data && size) return CONFERR_ERRFILE;
+
+	conf_registry_sink<N, Fn> sink = { &reg, &fn, unknown };
+	return conf_parse_all(data, size, conf_buffer_name, sink);
+} // parse_config_known_buffer()
+
+// Converters of option value to typed variable straight from input bytes
+// (std::from_chars, no intermediate std::string), *out is changed only
+// on success
+// return 0 on success or CONFERR_WRONGVALUE
+
+// any integer or floating point type
+template <class T>
+inline int conf_to_number(std::string_view v, T *out) {
+	const char *b = v.data(), *e = b + v.size();
+	if (b != e && *b == '+') {
+		b++;
+		if (b != e && *b == '-') return CONFERR_WRONGVALUE; // "+-5"
+	}
+	T n;
+	std::from_chars_result r = std::from_chars(b, e, n);
+	if (r.ec != std::errc() || r.ptr != e || b == e) return CONFERR_WRONGVALUE;
+	*out = n;
+	return 0;
+} // conf_to_number()
+
+inline int conf_to_int(std::string_view v, int64_t *out) {
+	return conf_to_number(v, out);
+} // conf_to_int()
+
+inline int conf_to_double(std::string_view v, double *out) {
+	return conf_to_number(v, out);
+} // conf_to_double()
+
+// case insensitive compare with lower case word
+inline bool conf_word_eq(std::string_view v, std::string_view lower) {
+	if (v.size() != lower.size()) return false;
+	for (size_t i = 0; i < v.size(); i++)
+		if ((v[i] | 0x20) != lower[i]) return false;
+	return true;
+}
+
+// true/false, yes/no, on/off, 1/0 in any case
+inline int conf_to_bool(std::string_view v, bool *out) {
+	if (conf_word_eq(v, "true") || conf_word_eq(v, "yes") || conf_word_eq(v, "on") || v == "1") {
+		*out = true; return 0;
+	}
+	if (conf_word_eq(v, "false") || conf_word_eq(v, "no") || conf_word_eq(v, "off") || v == "0") {
+		*out = false; return 0;
+	}
+	return CONFERR_WRONGVALUE;
+} // conf_to_bool()
+
+// size in bytes with optional K, M or G suffix (1024 based)
+inline int conf_to_size(std::string_view v, uint64_t *out) {
+	const char *b = v.data(), *e = b + v.size();
+	uint64_t n;
+	std::from_chars_result r = std::from_chars(b, e, n);
+	if (r.ec != std::errc() || r.ptr == b) return CONFERR_WRONGVALUE;
+
+	int shift = 0;
+	if (r.ptr != e) {
+		if (e - r.ptr != 1) return CONFERR_WRONGVALUE;
+		switch (*r.ptr | 0x20) {
+		case 'k': shift = 10; break;
+		case 'm': shift = 20; break;
+		case 'g': shift = 30; break;
+		default: return CONFERR_WRONGVALUE;
+		}
+	}
+	if (n > (UINT64_MAX >> shift)) return CONFERR_WRONGVALUE;
+	*out = n << shift;
+	return 0;
+} // conf_to_size()
+
+// duration with ms, s or m suffix, number without suffix is milliseconds
+inline int conf_to_duration(std::string_view v, std::chrono::milliseconds *out) {
+	const char *b = v.data(), *e = b + v.size();
+	int64_t n;
+	std::from_chars_result r = std::from_chars(b, e, n);
+	if (r.ec != std::errc() || r.ptr == b || n < 0) return CONFERR_WRONGVALUE;
+
+	std::string_view unit(r.ptr, e - r.ptr);
+	int64_t mul;
+	if (unit.empty() || unit == "ms") mul = 1;
+	else if (unit == "s") mul = 1000;
+	else if (unit == "m") mul = 60000;
+	else return CONFERR_WRONGVALUE;
+	if (n > INT64_MAX / mul) return CONFERR_WRONGVALUE;
+	*out = std::chrono::milliseconds(n * mul);
+	return 0;
+} // conf_to_duration()
+
+// position of v in names list
+inline int conf_to_enum(std::string_view v, const std::string_view *names, size_t count, int *out) {
+	for (size_t i = 0; i < count; i++) {
+		if (names[i] == v) { *out = i; return 0; }
+	}
+	return CONFERR_WRONGVALUE;
+} // conf_to_enum()
+
+enum conf_type {
+	CONF_TYPE_STRING // std::string
+	, CONF_TYPE_INT // int64_t
+	, CONF_TYPE_DOUBLE // double
+	, CONF_TYPE_BOOL // bool
+	, CONF_TYPE_SIZE // uint64_t bytes, value with K/M/G suffix
+	, CONF_TYPE_DURATION // std::chrono::milliseconds, value with ms/s/m suffix
+	, CONF_TYPE_ENUM // int position in enum_names
+};
+
+// Typed option of schema: value of option name is converted by type
+// into variable var while parsing
+struct conf_option {
+	std::string_view name;
+	conf_type type;
+	void *var;
+	const std::string_view *enum_names;
+	size_t enum_count;
+};
+
+inline conf_option conf_bind(std::string_view name, std::string *var) { return { name, CONF_TYPE_STRING, var, nullptr, 0 }; }
+inline conf_option conf_bind(std::string_view name, int64_t *var) { return { name, CONF_TYPE_INT, var, nullptr, 0 }; }
+inline conf_option conf_bind(std::string_view name, double *var) { return { name, CONF_TYPE_DOUBLE, var, nullptr, 0 }; }
+inline conf_option conf_bind(std::string_view name, bool *var) { return { name, CONF_TYPE_BOOL, var, nullptr, 0 }; }
+inline conf_option conf_bind(std::string_view name, std::chrono::milliseconds *var) { return { name, CONF_TYPE_DURATION, var, nullptr, 0 }; }
+inline conf_option conf_bind_size(std::string_view name, uint64_t *var) { return { name, CONF_TYPE_SIZE, var, nullptr, 0 }; }
+template <size_t N>
+inline conf_option conf_bind_enum(std::string_view name, int *var, const std::string_view (&names)[N]) {
+	return { name, CONF_TYPE_ENUM, var, names, N };
+}
+
+// convert value of option to its variable
+// return 0 on success or CONFERR_WRONGVALUE
+inline int conf_option_set(const conf_option &opt, std::string_view value) {
+	switch (opt.type) {
+	case CONF_TYPE_STRING: static_cast<std::string *>(opt.var)->assign(value); return 0;
+	case CONF_TYPE_INT: return conf_to_int(value, static_cast<int64_t *>(opt.var));
+	case CONF_TYPE_DOUBLE: return conf_to_double(value, static_cast<double *>(opt.var));
+	case CONF_TYPE_BOOL: return conf_to_bool(value, static_cast<bool *>(opt.var));
+	case CONF_TYPE_SIZE: return conf_to_size(value, static_cast<uint64_t *>(opt.var));
+	case CONF_TYPE_DURATION: return conf_to_duration(value, static_cast<std::chrono::milliseconds *>(opt.var));
+	case CONF_TYPE_ENUM: return conf_to_enum(value, opt.enum_names, opt.enum_count, static_cast<int *>(opt.var));
+	}
+	return CONFERR_WRONGVALUE;
+} // conf_option_set()
+
+// Sink for conf_parse_block() which converts options of schema into
+// their variables, stops on unknown option or wrong value.
+// Schema names are hashed once per parse, so every option is found by
+// one lookup (first schema entry with the same name wins).
+struct conf_schema_sink {
+	const conf_option *opts;
+	std::string *bad_name;
+	std::unordered_map<std::string_view, size_t> index; // name => position in opts
+
+	conf_schema_sink(const conf_option *opts, size_t count, std::string *bad_name)
+		: opts(opts), bad_name(bad_name)
+	{
+		index.reserve(count);
+		for (size_t i = 0; i < count; i++) index.emplace(opts[i].name, i);
+	}
+
+	int operator()(std::string_view name, std::string_view value) {
+		auto it = index.find(name);
+		int err = it == index.end() ? CONFERR_WRONGPARAM : conf_option_set(opts[it->second], value);
+		if (err && bad_name) bad_name->assign(name);
+		return err;
+	}
+};
+
+// Parse config file file_name and convert options into variables of
+// schema opts[count], name of unknown option or option with wrong value
+// is stored to *bad_name if given (variables set before error keep
+// new values)
+// return 0 on success or some error code
+inline int parse_config_typed(std::string file_name, const conf_option *opts, size_t count,
+	std::string *bad_name = nullptr)
+{
+	conf_schema_sink sink = { opts, count, bad_name };
+	return conf_parse_file(file_name, sink);
+} // parse_config_typed()
+
+template <size_t N>
+inline int parse_config_typed(std::string file_name, const conf_option (&opts)[N], std::string *bad_name = nullptr) {
+	return parse_config_typed(file_name, opts, N, bad_name);
+} // parse_config_typed()
+
+// Same as parse_config_typed() for config in memory buffer [data, data + size)
+inline int parse_config_typed_buffer(const char *data, size_t size, const conf_option *opts, size_t count,
+	std::string *bad_name = nullptr)
+{
+	if (!data && size) return CONFERR_ERRFILE;
+
+	conf_schema_sink sink = { opts, count, bad_name };
+	return conf_parse_all(data, size, conf_buffer_name, sink);
+} // parse_config_typed_buffer()
+
+// Converter of value by type of variable, used by struct binding,
+// add own overload of conf_convert() for other field types
+inline int conf_convert(std::string_view v, std::string *out) { out->assign(v); return 0; }
+inline int conf_convert(std::string_view v, bool *out) { return conf_to_bool(v, out); }
+inline int conf_convert(std::string_view v, std::chrono::milliseconds *out) { return conf_to_duration(v, out); }
+
+template <class T>
+inline std::enable_if_t<std::is_arithmetic_v<T> && !std::is_same_v<T, bool>, int>
+conf_convert(std::string_view v, T *out) {
+	return conf_to_number(v, out);
+}
+
+// Field of struct T bound to option name
+template <class T, class M>
+struct conf_field {
+	std::string_view name;
+	M T::*member;
+};
+
+template <class T, class M>
+constexpr conf_field<T, M> conf_make_field(std::string_view name, M T::*member) {
+	return { name, member };
+}
+
+// Description of fields of struct T, made by CONF_STRUCT() macro:
+//   struct mysql_config { std::string host; int port; };
+//   CONF_STRUCT(mysql_config, CONF_FIELD(mysql_config, host), CONF_FIELD(mysql_config, port))
+// and then parse_config_struct("my.conf", &cfg) fills cfg fields
+template <class T>
+struct conf_struct;
+
+#define CONF_FIELD(T, f) conf_make_field(#f, &T::f)
+#define CONF_STRUCT(T, ...) \
+	template <> struct conf_struct<T> { \
+		static constexpr auto fields = std::make_tuple(__VA_ARGS__); \
 	};
 
-	// result of parsing container
-	std::unordered_map<std::string, std::string> conf;
+template <class T, size_t... I>
+constexpr std::array<std::string_view, sizeof...(I)> conf_struct_names(std::index_sequence<I...>) {
+	return {{ std::get<I>(conf_struct<T>::fields).name... }};
+}
+
+template <class T>
+constexpr size_t conf_struct_size = std::tuple_size_v<std::remove_const_t<decltype(conf_struct<T>::fields)>>;
+
+// perfect hash of field names of T, built at compile time
+template <class T>
+inline constexpr conf_key_registry<conf_struct_size<T>> conf_struct_registry(
+	conf_struct_names<T>(std::make_index_sequence<conf_struct_size<T>>()));
+
+template <class T, size_t I>
+inline int conf_struct_set_field(T *obj, std::string_view value) {
+	return conf_convert(value, &(obj->*std::get<I>(conf_struct<T>::fields).member));
+}
+
+// setters of fields of T by field position
+template <class T, size_t... I>
+constexpr std::array<int (*)(T *, std::string_view), sizeof...(I)> conf_struct_setters(std::index_sequence<I...>) {
+	return {{ &conf_struct_set_field<T, I>... }};
+}
+
+// Sink for conf_parse_block() which writes options straight into fields
+// of struct T, stops on unknown option or wrong value
+template <class T>
+struct conf_struct_sink {
+	T *obj;
+	std::string *bad_name;
+
+	int operator()(std::string_view name, std::string_view value) {
+		static constexpr auto setters = conf_struct_setters<T>(std::make_index_sequence<conf_struct_size<T>>());
+		int i = conf_struct_registry<T>.index(name);
+		int err = i < 0 ? CONFERR_WRONGPARAM : setters[i](obj, value);
+		if (err && bad_name) bad_name->assign(name);
+		return err;
+	}
+};
+
+// Parse config file file_name straight into fields of *ret described by
+// CONF_STRUCT(), no map is built, name of unknown option or option with
+// wrong value is stored to *bad_name if given
+// return 0 on success or some error code
+template <class T>
+inline int parse_config_struct(std::string file_name, T *ret, std::string *bad_name = nullptr) {
+	if (!ret) return CONFERR_NORET;
+	conf_struct_sink<T> sink = { ret, bad_name };
+	return conf_parse_file(file_name, sink);
+} // parse_config_struct()
+
+// Same as parse_config_struct() for config in memory buffer [data, data + size)
+template <class T>
+inline int parse_config_struct_buffer(const char *data, size_t size, T *ret, std::string *bad_name = nullptr) {
+	if (!ret) return CONFERR_NORET;
+	if (!data && size) return CONFERR_ERRFILE;
+
+	conf_struct_sink<T> sink = { ret, bad_name };
+	return conf_parse_all(data, size, conf_buffer_name, sink);
+} // parse_config_struct_buffer()
+
+/*
+// Example of usage (needs #include <iostream> for output)
+
+// options of program read from config file with default values
+struct mysql_config {
+	std::string host = "127.0.0.1";
+	std::string user = "root";
+	std::string password = "strongrootpassword";
+	std::string database = "database";
+	int port = 3306;
+};
+
+// list of known options, each bound to the struct field with the same name
+CONF_STRUCT(mysql_config
+	, CONF_FIELD(mysql_config, host)
+	, CONF_FIELD(mysql_config, user)
+	, CONF_FIELD(mysql_config, password)
+	, CONF_FIELD(mysql_config, database)
+	, CONF_FIELD(mysql_config, port)
+)
+
+int main() {
+
+	std::string config_file_name  = "test.conf";
 
 	std::ofstream outconf(config_file_name);
 	if (outconf) {
@@ -283,6 +1802,7 @@ int main() {
 		<< "user      =       'dba_admin'" << std::endl
 		<< "password = helloworld # test comment" << std::endl
 		<< "database=testdb123" << std::endl
+		<< "port = 3307" << std::endl
 		// << "unknown = 'test unknown value' # uncomment this line for test" << std::endl
 		;
 		outconf.close();
@@ -291,23 +1811,15 @@ int main() {
 		return -1;
 	}
 
+	// print place of syntax error to stderr (nothing is printed by default)
+	conf_on_error(conf_print_error);
+
+	// parse to container of all "option"=>"value" pairs
+	std::unordered_map<std::string, std::string> conf;
 
-	// call parser
 	if (parse_config(config_file_name, &conf) == 0) {
 		for (auto c = conf.begin(); c != conf.end(); c++) {
 			std::cout << "param=" << c->first << " value=" << c->second << std::endl;
-
-			bool found = false;
-			for (auto i = conf_params.begin(); i != conf_params.end(); i++) {
-				if (i->name.compare(c->first) == 0) {
-					*i->var_ptr = c->second;
-					found = true; break;
-				};
-			}
-			if (!found) {
-				std::cerr << "Unknown parameter \"" << c->first << "\"" << std::endl;
-				return -1;
-			}
 		}
 	} else {
 		std::cerr << "Can't parse config file " << config_file_name << std::endl;
@@ -316,12 +1828,36 @@ int main() {
 
 	conf.clear();
 
+	// lint: all syntax errors of config in one pass, no values are built
+	std::vector<conf_error> errors;
+	if (conf_validate(config_file_name, &errors) != 0) {
+		for (const conf_error &e : errors)
+			std::cerr << config_file_name << ":" << e.line << ":" << e.column << ": " << e.what << std::endl;
+	}
+
+	// or parse straight into the struct fields
+	mysql_config mysql;
+	std::string bad_name;
+
+	int err = parse_config_struct(config_file_name, &mysql, &bad_name);
+	if (err == CONFERR_WRONGPARAM && !bad_name.empty()) {
+		std::cerr << "Unknown parameter \"" << bad_name << "\"" << std::endl;
+		return -1;
+	} else if (err == CONFERR_WRONGVALUE) {
+		std::cerr << "Wrong value of parameter \"" << bad_name << "\"" << std::endl;
+		return -1;
+	} else if (err) {
+		std::cerr << "Can't parse config file " << config_file_name << std::endl;
+		return -1;
+	}
+
 	std::cout << std::endl
 		<< "MySQL config" << std::endl
-		<< "- host: " << mysql_host << std::endl
-		<< "- user: " << mysql_user << std::endl
-		<< "- password: " << mysql_password << std::endl
-		<< "- database: " << mysql_database << std::endl
+		<< "- host: " << mysql.host << std::endl
+		<< "- user: " << mysql.user << std::endl
+		<< "- password: " << mysql.password << std::endl
+		<< "- database: " << mysql.database << std::endl
+		<< "- port: " << mysql.port << std::endl
 	;
 
 	return 0;
@@ -0,0 +1,458 @@
+/*
+* cpp_parse_config_cache.hpp
+*
+* Precompiled binary cache of parsed config for cpp_parse_config.hpp.
+* Parsed options are written once into a versioned and checksummed
+* file (hash index plus string table) which is used straight from
+* mmap on next starts: no parsing and no deserialization. Cache is
+* checked against size, mtime and hash of source text and compiled
+* again when it is stale.
+*
+* Licensed under GNU General Public License v3
+*
+* Author: Kuzin Andrey <kuzinandrey@yandex.ru>
+* (c) 2021
+*/
+#ifndef CPP_PARSE_CONFIG_CACHE_H
+#define CPP_PARSE_CONFIG_CACHE_H
+
+#include "cpp_parse_config.hpp"
+
+#ifndef CONF_HAVE_MMAP
+#error "cpp_parse_config_cache.hpp needs mmap"
+#endif
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+
+#define CONF_CACHE_MAGIC "CONFCCH" // 8 bytes with terminating zero
+#define CONF_CACHE_VERSION 1
+#define CONF_CACHE_BYTE_ORDER 0x01020304u // cache is read on the same byte order only
+
+// Cache file layout, all offsets are from file begin:
+//   conf_cache_header
+//   slots [table_size] conf_cache_slot - open addressing by conf_hash()
+//   entries [count] uint32_t - slot indexes in file order
+//   strings [strings_size] - records [u32 value length][key][value]
+struct conf_cache_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint64_t size; // whole cache size
+	uint64_t checksum; // conf_hash() of all bytes after header
+	uint64_t src_size;
+	int64_t src_mtime_sec;
+	int64_t src_mtime_nsec;
+	uint64_t src_hash; // conf_hash() of source text
+	uint64_t count; // options
+	uint64_t table_size; // slots, power of two
+	uint64_t slots_off;
+	uint64_t entries_off;
+	uint64_t strings_off;
+	uint64_t strings_size;
+};
+
+struct conf_cache_slot {
+	uint32_t tag; // high bits of hash, 0 for empty slot
+	uint32_t key_len;
+	uint64_t off; // record offset in strings
+};
+
+static_assert(sizeof(conf_cache_header) % 8 == 0, "cache header keeps slots aligned");
+static_assert(sizeof(conf_cache_slot) == 16, "cache slot is 16 bytes");
+
+// Source file identity kept in cache
+struct conf_cache_source {
+	uint64_t size = 0;
+	int64_t mtime_sec = 0;
+	int64_t mtime_nsec = 0;
+};
+
+inline void conf_cache_source_of(const struct stat &sb, conf_cache_source *src) {
+	src->size = sb.st_size;
+#ifdef __APPLE__
+	src->mtime_sec = sb.st_mtimespec.tv_sec;
+	src->mtime_nsec = sb.st_mtimespec.tv_nsec;
+#else
+	src->mtime_sec = sb.st_mtim.tv_sec;
+	src->mtime_nsec = sb.st_mtim.tv_nsec;
+#endif
+} // conf_cache_source_of()
+
+inline int conf_cache_stat(const std::string &file_name, conf_cache_source *src) {
+	struct stat sb;
+	if (stat(file_name.c_str(), &sb) != 0) return CONFERR_ERRFILE;
+	conf_cache_source_of(sb, src);
+	return 0;
+} // conf_cache_stat()
+
+// Read whole source file file_name into *text, *sb (if given) is stat
+// of the same open file taken before read: size and mtime which are
+// kept in cache are never newer than the text
+// return 0 on success or some error code
+inline int conf_cache_read_text(const std::string &file_name, std::string *text,
+	struct stat *sb = nullptr)
+{
+	int fd = open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) return CONFERR_ERRFILE;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0) { close(fd); return CONFERR_ERRFILE; }
+
+	// one byte more than size: file which grows while read is noticed
+	text->resize(static_cast<size_t>(st.st_size) + 1);
+	size_t got = 0;
+	while (got < text->size()) {
+		ssize_t n = ::read(fd, &(*text)[got], text->size() - got);
+		if (n < 0 && errno == EINTR) continue;
+		if (n < 0) { close(fd); return CONFERR_ERRFILE; }
+		if (n == 0) break;
+		got += n;
+	}
+	close(fd);
+	text->resize(got);
+	if (got != static_cast<size_t>(st.st_size)) return CONFERR_ERRFILE; // changed while read
+	if (sb) *sb = st;
+	return 0;
+} // conf_cache_read_text()
+
+// Read-only options of compiled cache, used in place from mapped file
+// (or from memory when cache file can't be written)
+class conf_cache {
+public:
+	conf_cache() {}
+	conf_cache(const conf_cache &) = delete;
+	conf_cache &operator=(const conf_cache &) = delete;
+	conf_cache(conf_cache &&other) { *this = std::move(other); }
+	conf_cache &operator=(conf_cache &&other) {
+		if (this != &other) {
+			release();
+			owned = std::move(other.owned);
+			map_addr = other.map_addr; map_size = other.map_size;
+			other.map_addr = nullptr; other.map_size = 0;
+			attach(owned.empty() ? static_cast<const char *>(map_addr) : owned.data());
+			other.attach(nullptr);
+		}
+		return *this;
+	}
+	~conf_cache() { release(); }
+
+	// find option key, return true and its value in *value if found
+	bool find(std::string_view key, std::string_view *value = nullptr) const {
+		if (!hdr) return false;
+		uint64_t h = conf_hash(key);
+		uint32_t tag = h >> 32 ? h >> 32 : 1;
+		size_t mask = hdr->table_size - 1;
+		for (size_t i = h & mask; ; i = (i + 1) & mask) {
+			const conf_cache_slot &s = slots[i];
+			if (!s.tag) return false;
+			if (s.tag == tag && s.key_len == key.size()
+				&& std::memcmp(strings + s.off + sizeof(uint32_t), key.data(), key.size()) == 0)
+			{
+				if (value) *value = value_of(s);
+				return true;
+			}
+		}
+	}
+
+	// value of option key or def if not found
+	std::string_view get(std::string_view key, std::string_view def = std::string_view()) const {
+		std::string_view v;
+		return find(key, &v) ? v : def;
+	}
+
+	// options in file order: key(i), value(i) for i < size()
+	size_t size() const { return hdr ? hdr->count : 0; }
+	std::string_view key(size_t i) const {
+		const conf_cache_slot &s = slots[entries[i]];
+		return std::string_view(strings + s.off + sizeof(uint32_t), s.key_len);
+	}
+	std::string_view value(size_t i) const { return value_of(slots[entries[i]]); }
+
+	// true if options are used from mapped cache file
+	bool mapped() const { return map_addr != nullptr; }
+
+	void release() {
+		attach(nullptr);
+		owned.clear(); owned.shrink_to_fit();
+		if (map_addr) munmap(map_addr, map_size);
+		map_addr = nullptr; map_size = 0;
+	}
+
+private:
+	std::string owned;
+	void *map_addr = nullptr;
+	size_t map_size = 0;
+	const conf_cache_header *hdr = nullptr;
+	const conf_cache_slot *slots = nullptr;
+	const uint32_t *entries = nullptr;
+	const char *strings = nullptr;
+
+	void attach(const char *base) {
+		hdr = reinterpret_cast<const conf_cache_header *>(base);
+		slots = base ? reinterpret_cast<const conf_cache_slot *>(base + hdr->slots_off) : nullptr;
+		entries = base ? reinterpret_cast<const uint32_t *>(base + hdr->entries_off) : nullptr;
+		strings = base ? base + hdr->strings_off : nullptr;
+	}
+
+	std::string_view value_of(const conf_cache_slot &s) const {
+		uint32_t value_len;
+		std::memcpy(&value_len, strings + s.off, sizeof(value_len));
+		return std::string_view(strings + s.off + sizeof(uint32_t) + s.key_len, value_len);
+	}
+
+	friend int conf_cache_map_fd(int fd, conf_cache *ret);
+	friend int conf_cache_open(const std::string &cache_name, const conf_cache_source *src,
+		const std::string &file_name, conf_cache *ret);
+	friend int parse_config_cached(std::string file_name, std::string cache_name, conf_cache *ret);
+};
+
+// Build cache image of options map (first option with the same name
+// wins, it is already so in map) into *out
+inline void conf_cache_build(const conf_flat_map &m, const conf_cache_source &src,
+	uint64_t src_hash, std::string *out)
+{
+	size_t count = m.size();
+	size_t table_size = 16;
+	while (table_size < count * 2) table_size <<= 1;
+
+	std::vector<conf_cache_slot> slots(table_size);
+	std::vector<uint32_t> entries(count);
+	std::string strings;
+	size_t mask = table_size - 1;
+	for (size_t n = 0; n < count; n++) {
+		std::string_view key = m.key(n);
+		std::string_view value = m.value(n);
+		uint64_t h = conf_hash(key);
+		size_t i = h & mask;
+		while (slots[i].tag) i = (i + 1) & mask; // keys are unique already
+		slots[i].tag = h >> 32 ? h >> 32 : 1;
+		slots[i].key_len = key.size();
+		slots[i].off = strings.size();
+		uint32_t value_len = value.size();
+		strings.append(reinterpret_cast<const char *>(&value_len), sizeof(value_len));
+		strings.append(key);
+		strings.append(value);
+		entries[n] = i;
+	}
+
+	conf_cache_header h;
+	std::memset(&h, 0, sizeof(h));
+	std::memcpy(h.magic, CONF_CACHE_MAGIC, sizeof(h.magic));
+	h.version = CONF_CACHE_VERSION;
+	h.byte_order = CONF_CACHE_BYTE_ORDER;
+	h.src_size = src.size;
+	h.src_mtime_sec = src.mtime_sec;
+	h.src_mtime_nsec = src.mtime_nsec;
+	h.src_hash = src_hash;
+	h.count = count;
+	h.table_size = table_size;
+	h.slots_off = sizeof(h);
+	h.entries_off = h.slots_off + table_size * sizeof(conf_cache_slot);
+	h.strings_off = h.entries_off + count * sizeof(uint32_t);
+	h.strings_size = strings.size();
+	h.size = h.strings_off + strings.size();
+
+	out->clear();
+	out->reserve(h.size);
+	out->append(reinterpret_cast<const char *>(&h), sizeof(h));
+	out->append(reinterpret_cast<const char *>(slots.data()), table_size * sizeof(conf_cache_slot));
+	out->append(reinterpret_cast<const char *>(entries.data()), count * sizeof(uint32_t));
+	out->append(strings);
+
+	uint64_t sum = conf_hash(std::string_view(out->data() + sizeof(h), out->size() - sizeof(h)));
+	std::memcpy(&(*out)[offsetof(conf_cache_header, checksum)], &sum, sizeof(sum));
+} // conf_cache_build()
+
+// Check that image [data, data + size) is a whole cache of this version:
+// header, checksum and every record bounds
+// return true if it can be used
+inline bool conf_cache_valid(const char *data, size_t size) {
+	if (size < sizeof(conf_cache_header)) return false;
+	const conf_cache_header *h = reinterpret_cast<const conf_cache_header *>(data);
+	if (std::memcmp(h->magic, CONF_CACHE_MAGIC, sizeof(h->magic)) != 0
+		|| h->version != CONF_CACHE_VERSION
+		|| h->byte_order != CONF_CACHE_BYTE_ORDER
+		|| h->size != size)
+	{
+		return false;
+	}
+	// every offset is bounded by size before it is used, so sums can't wrap
+	if (!h->table_size || h->table_size > size || (h->table_size & (h->table_size - 1))
+		|| h->count >= h->table_size
+		|| h->slots_off != sizeof(conf_cache_header)
+		|| h->entries_off != h->slots_off + h->table_size * sizeof(conf_cache_slot)
+		|| h->entries_off > size
+		|| h->strings_off != h->entries_off + h->count * sizeof(uint32_t)
+		|| h->strings_off > size
+		|| h->strings_size != size - h->strings_off)
+	{
+		return false;
+	}
+	if (conf_hash(std::string_view(data + sizeof(*h), size - sizeof(*h))) != h->checksum)
+		return false;
+
+	const conf_cache_slot *slots = reinterpret_cast<const conf_cache_slot *>(data + h->slots_off);
+	const char *strings = data + h->strings_off;
+	for (size_t i = 0; i < h->table_size; i++) {
+		const conf_cache_slot &s = slots[i];
+		if (!s.tag) continue;
+		if (s.off > h->strings_size) return false;
+		uint64_t room = h->strings_size - s.off;
+		if (room < sizeof(uint32_t) + uint64_t(s.key_len)) return false;
+		uint32_t value_len;
+		std::memcpy(&value_len, strings + s.off, sizeof(value_len));
+		if (room - sizeof(uint32_t) - s.key_len < value_len) return false;
+	}
+	const uint32_t *entries = reinterpret_cast<const uint32_t *>(data + h->entries_off);
+	for (size_t n = 0; n < h->count; n++)
+		if (entries[n] >= h->table_size || !slots[entries[n]].tag) return false;
+	return true;
+} // conf_cache_valid()
+
+// Parse text config file file_name and write its cache into cache_name
+// (through temporary file and rename, so readers never see half of it),
+// image is also left in *image if given
+// return 0 on success or some error code
+inline int conf_cache_compile(const std::string &file_name, const std::string &cache_name,
+	std::string *image = nullptr)
+{
+	std::string text;
+	struct stat sb;
+	if (conf_cache_read_text(file_name, &text, &sb) != 0) return CONFERR_ERRFILE;
+
+	conf_cache_source src;
+	conf_cache_source_of(sb, &src);
+
+	conf_flat_map m;
+	conf_flat_sink sink = { &m };
+	int err = conf_parse_all(text.data(), text.size(), file_name, sink);
+	if (err) return err;
+
+	std::string out;
+	conf_cache_build(m, src, conf_hash(text), &out);
+	if (image) *image = out;
+
+	// own temporary file in the cache directory: processes compiling the
+	// same cache at once don't write into one file. Cache holds values in
+	// plain text, so it is readable by the same users as source
+	std::string tmp_name = cache_name + ".XXXXXX";
+	int fd = mkstemp(&tmp_name[0]);
+	if (fd < 0) return CONFERR_ERRFILE;
+	bool written = fchmod(fd, sb.st_mode & 0666) == 0;
+	for (size_t done = 0; written && done < out.size(); ) {
+		ssize_t n = ::write(fd, out.data() + done, out.size() - done);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) written = false;
+		else done += n;
+	}
+	if (close(fd) != 0) written = false;
+	if (!written) { std::remove(tmp_name.c_str()); return CONFERR_ERRFILE; }
+	if (std::rename(tmp_name.c_str(), cache_name.c_str()) != 0) {
+		std::remove(tmp_name.c_str());
+		return CONFERR_ERRFILE;
+	}
+	return 0;
+} // conf_cache_compile()
+
+// Map cache image from open descriptor fd read-only into *ret if it is
+// valid (fd is not closed)
+// return 0 on success or some error code
+inline int conf_cache_map_fd(int fd, conf_cache *ret) {
+	struct stat sb;
+	if (fstat(fd, &sb) != 0 || sb.st_size < static_cast<off_t>(sizeof(conf_cache_header)))
+		return CONFERR_WRONGSYNTAX;
+
+	size_t size = sb.st_size;
+	void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) return CONFERR_ERRFILE;
+
+	if (!conf_cache_valid(static_cast<const char *>(map), size)) {
+		munmap(map, size);
+		return CONFERR_WRONGSYNTAX;
+	}
+
+	ret->release();
+	ret->map_addr = map;
+	ret->map_size = size;
+	ret->attach(static_cast<const char *>(map));
+	return 0;
+} // conf_cache_map_fd()
+
+// Map cache cache_name into *ret if it is valid and made from source src
+// (size and mtime are equal, or else hash of text of file_name is equal)
+// return 0 on success or some error code
+inline int conf_cache_open(const std::string &cache_name, const conf_cache_source *src,
+	const std::string &file_name, conf_cache *ret)
+{
+	int fd = open(cache_name.c_str(), O_RDONLY);
+	if (fd < 0) return CONFERR_ERRFILE;
+
+	conf_cache c;
+	int err = conf_cache_map_fd(fd, &c);
+	close(fd);
+	if (err) return err;
+
+	const conf_cache_header *h = c.hdr;
+	if (h->src_size != src->size) return CONFERR_WRONGVALUE;
+	if (h->src_mtime_sec != src->mtime_sec || h->src_mtime_nsec != src->mtime_nsec) {
+		// touched but maybe not changed: compare text hash
+		std::string text;
+		if (conf_cache_read_text(file_name, &text) != 0) return CONFERR_ERRFILE;
+		if (conf_hash(text) != h->src_hash) return CONFERR_WRONGVALUE;
+
+		// the same text: store new mtime (header is out of checksum), so
+		// next start doesn't read text again, it's fine if this fails
+		int wfd = open(cache_name.c_str(), O_WRONLY);
+		if (wfd >= 0) {
+			int64_t mtime[2] = { src->mtime_sec, src->mtime_nsec };
+			if (pwrite(wfd, mtime, sizeof(mtime), offsetof(conf_cache_header, src_mtime_sec)) < 0) {
+				// cache stays valid, only slower to check
+			}
+			close(wfd);
+		}
+	}
+
+	*ret = std::move(c);
+	return 0;
+} // conf_cache_open()
+
+// Load options of config file file_name from its cache cache_name; when
+// cache is missed, broken or stale config is parsed and cache is written
+// again, when cache can't be written options are kept in memory
+// return 0 on success or some error code
+inline int parse_config_cached(std::string file_name, std::string cache_name, conf_cache *ret) {
+	if (!ret) return CONFERR_NORET;
+	ret->release();
+
+	conf_cache_source src;
+	if (conf_cache_stat(file_name, &src) != 0) return CONFERR_ERRFILE;
+	if (conf_cache_open(cache_name, &src, file_name, ret) == 0) return 0;
+
+	std::string image;
+	int err = conf_cache_compile(file_name, cache_name, &image);
+	if (err == 0 && conf_cache_open(cache_name, &src, file_name, ret) == 0) return 0;
+	if (image.empty()) return err ? err : CONFERR_ERRFILE; // text itself is not parsed
+
+	// no writable cache: use image from memory
+	ret->owned = std::move(image);
+	ret->attach(ret->owned.data());
+	return 0;
+} // parse_config_cached()
+
+/*
+// Example of usage
+int main() {
+	conf_cache conf;
+	// first start parses test.conf and writes test.conf.cache, next
+	// starts only map test.conf.cache until test.conf is changed
+	if (parse_config_cached("test.conf", "test.conf.cache", &conf) != 0) return -1;
+
+	std::string_view host = conf.get("host", "localhost");
+	...
+}
+*/
+
+#endif /* CPP_PARSE_CONFIG_CACHE_H */
@@ -0,0 +1,435 @@
+/*
+* cpp_parse_config_daemon.hpp
+*
+* Local config daemon for cpp_parse_config.hpp: one process owns parsed
+* config and answers lookups of other processes over Unix domain
+* socket with compact binary protocol. Client keeps found values in
+* its own cache, daemon pushes new generation number to all clients on
+* reload and clients drop their caches.
+*
+* Protocol, integers are in byte order of host (socket is local):
+*   request  CONF_OP_GET   [u8 op][u32 key length][key]
+*   answer   CONF_OP_VALUE [u8 op][u8 found][u64 generation][u32 value length][value]
+*   push     CONF_OP_GEN   [u8 op][u64 generation] (on connect and on every reload)
+*
+* Licensed under GNU General Public License v3
+*
+* Author: Kuzin Andrey <kuzinandrey@yandex.ru>
+* (c) 2021
+*/
+#ifndef CPP_PARSE_CONFIG_DAEMON_H
+#define CPP_PARSE_CONFIG_DAEMON_H
+
+#include "cpp_parse_config.hpp"
+
+#ifndef CONF_HAVE_MMAP
+#error "cpp_parse_config_daemon.hpp needs POSIX"
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <thread>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define CONF_OP_GET 1
+#define CONF_OP_VALUE 2
+#define CONF_OP_GEN 3
+
+#ifndef CONF_DAEMON_MAX_KEY
+#define CONF_DAEMON_MAX_KEY 4096 // longer keys are not served (answered as not found)
+#endif
+
+// fill sockaddr_un for path
+// return false if path is too long
+inline bool conf_unix_addr(const std::string &path, struct sockaddr_un *addr) {
+	std::memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	if (path.size() >= sizeof(addr->sun_path)) return false;
+	std::memcpy(addr->sun_path, path.c_str(), path.size() + 1);
+	return true;
+} // conf_unix_addr()
+
+// put integer into frame
+template <class T>
+inline void conf_put(std::string *out, T v) {
+	out->append(reinterpret_cast<const char *>(&v), sizeof(v));
+} // conf_put()
+
+// take integer from frame
+template <class T>
+inline T conf_take(const char *p) {
+	T v;
+	std::memcpy(&v, p, sizeof(v));
+	return v;
+} // conf_take()
+
+// Config daemon: parses file_name, listens on socket_path and serves
+// lookups from its thread with poll() over all clients
+class conf_daemon {
+public:
+	conf_daemon(std::string file_name, std::string socket_path)
+		: file_name(file_name), socket_path(socket_path) {}
+	conf_daemon(const conf_daemon &) = delete;
+	conf_daemon &operator=(const conf_daemon &) = delete;
+	~conf_daemon() { stop(); }
+
+	// parse config, listen socket and start serving thread, errors of
+	// reloads go to error handler of thread calling start()
+	// return 0 on success or some error code
+	int start() {
+		if (thread.joinable()) return 0;
+		errors.to = conf_thread_error_handler();
+
+		int err = parse_config(file_name, &values);
+		if (err) return err;
+		gen = 1;
+
+		struct sockaddr_un addr;
+		if (!conf_unix_addr(socket_path, &addr)) return CONFERR_ERRFILE;
+		listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (listen_fd < 0) return CONFERR_ERRFILE;
+		unlink(socket_path.c_str());
+		if (bind(listen_fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0
+			|| listen(listen_fd, 128) != 0 || pipe2(wake, O_NONBLOCK | O_CLOEXEC) != 0)
+		{
+			close(listen_fd); listen_fd = -1;
+			return CONFERR_ERRFILE;
+		}
+
+		stopping = false; // daemon may be started again after stop()
+		thread = std::thread(&conf_daemon::run, this);
+		return 0;
+	}
+
+	// stop serving thread, close all clients and remove socket
+	void stop() {
+		if (thread.joinable()) {
+			stopping = true;
+			char c = 's';
+			if (write(wake[1], &c, 1) < 0) { /* full pipe wakes thread anyway */ }
+			thread.join();
+		}
+		for (client &c : clients) close(c.fd);
+		clients.clear();
+		if (listen_fd >= 0) { close(listen_fd); listen_fd = -1; unlink(socket_path.c_str()); }
+		if (wake[0] >= 0) { close(wake[0]); close(wake[1]); wake[0] = wake[1] = -1; }
+	}
+
+	// ask serving thread to parse config again and push new generation
+	// to clients, async-signal-safe (may be called from SIGHUP handler)
+	void reload() {
+		char c = 'r';
+		// pipe is non-blocking: full pipe means reload is already pending
+		if (wake[1] >= 0 && write(wake[1], &c, 1) < 0) { /* nothing to do */ }
+	}
+
+	// number of loaded generation, error of last reload
+	uint64_t generation() const { return gen.load(std::memory_order_acquire); }
+	int last_error() const { return reload_err.load(std::memory_order_acquire); }
+
+private:
+	struct client {
+		int fd;
+		std::string in;
+		std::string out;
+		uint64_t skip = 0; // bytes of too long key still to drop
+	};
+
+	std::string file_name;
+	std::string socket_path;
+	std::unordered_map<std::string,std::string> values; // only serving thread uses it
+	std::atomic<uint64_t> gen{0};
+	std::atomic<int> reload_err{0};
+	std::atomic<bool> stopping{false};
+	int listen_fd = -1;
+	int wake[2] = { -1, -1 };
+	std::vector<client> clients;
+	std::thread thread;
+	conf_error_relay errors; // handler of thread which called start()
+
+	void push_gen(client &c) {
+		c.out.push_back(CONF_OP_GEN);
+		conf_put<uint64_t>(&c.out, gen.load(std::memory_order_relaxed));
+	}
+
+	void do_reload() {
+		std::unordered_map<std::string,std::string> fresh;
+		int err = parse_config(file_name, &fresh);
+		reload_err.store(err, std::memory_order_release);
+		if (err) return; // old config is served further
+		values.swap(fresh);
+		gen.fetch_add(1, std::memory_order_release);
+		for (client &c : clients) push_gen(c);
+	}
+
+	// queue answer with value (nullptr - not found)
+	void answer(client &c, const std::string *value) {
+		c.out.push_back(CONF_OP_VALUE);
+		c.out.push_back(value != nullptr);
+		conf_put<uint64_t>(&c.out, gen.load(std::memory_order_relaxed));
+		conf_put<uint32_t>(&c.out, value ? value->size() : 0);
+		if (value) c.out.append(*value);
+	}
+
+	// handle complete requests in c.in
+	// return false if client sent garbage
+	bool handle(client &c) {
+		size_t pos = 0;
+		for (;;) {
+			if (c.skip) {
+				size_t n = std::min<uint64_t>(c.skip, c.in.size() - pos);
+				pos += n;
+				c.skip -= n;
+				if (c.skip) break;
+			}
+			if (c.in.size() - pos < 5) break;
+			const char *p = c.in.data() + pos;
+			if (p[0] != CONF_OP_GET) return false;
+			uint32_t len = conf_take<uint32_t>(p + 1);
+			if (len > CONF_DAEMON_MAX_KEY) {
+				// key is not buffered, its bytes are dropped as they come
+				answer(c, nullptr);
+				pos += 5;
+				c.skip = len;
+				continue;
+			}
+			if (c.in.size() - pos < 5 + len) break;
+
+			auto it = values.find(std::string(p + 5, len));
+			answer(c, it != values.end() ? &it->second : nullptr);
+			pos += 5 + len;
+		}
+		c.in.erase(0, pos);
+		return true;
+	}
+
+	// send as much of c.out as socket takes
+	// return false if client is gone
+	bool flush(client &c) {
+		while (!c.out.empty()) {
+			ssize_t n = send(c.fd, c.out.data(), c.out.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+			if (n < 0) {
+				if (errno == EINTR) continue;
+				return errno == EAGAIN || errno == EWOULDBLOCK;
+			}
+			c.out.erase(0, n);
+		}
+		return true;
+	}
+
+	void run() {
+		errors.install();
+		std::vector<struct pollfd> fds;
+		char buf[65536];
+
+		while (!stopping) {
+			fds.resize(2 + clients.size());
+			fds[0] = { wake[0], POLLIN, 0 };
+			fds[1] = { listen_fd, POLLIN, 0 };
+			for (size_t i = 0; i < clients.size(); i++)
+				fds[2 + i] = { clients[i].fd, static_cast<short>(POLLIN | (clients[i].out.empty() ? 0 : POLLOUT)), 0 };
+
+			if (poll(fds.data(), fds.size(), -1) < 0) {
+				if (errno == EINTR) continue;
+				break;
+			}
+
+			if (fds[0].revents & POLLIN) {
+				ssize_t n = read(wake[0], buf, sizeof(buf));
+				bool want_reload = false;
+				for (ssize_t i = 0; i < n; i++) if (buf[i] == 'r') want_reload = true;
+				if (stopping) break;
+				if (want_reload) do_reload(); // many signals make one reload
+			}
+
+			// clients first: indexes in fds are of current clients
+			for (size_t i = clients.size(); i-- > 0; ) {
+				client &c = clients[i];
+				short ev = fds[2 + i].revents;
+				bool alive = true;
+				if (ev & (POLLIN | POLLHUP | POLLERR)) {
+					ssize_t n = recv(c.fd, buf, sizeof(buf), MSG_DONTWAIT);
+					if (n > 0) {
+						c.in.append(buf, n);
+						alive = handle(c);
+					} else if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+						alive = false;
+					}
+				}
+				if (alive) alive = flush(c);
+				if (!alive) {
+					close(c.fd);
+					clients.erase(clients.begin() + i);
+				}
+			}
+
+			if (fds[1].revents & POLLIN) {
+				int fd = accept(listen_fd, nullptr, nullptr);
+				if (fd >= 0) {
+					clients.push_back({ fd, std::string(), std::string(), 0 });
+					push_gen(clients.back());
+					if (!flush(clients.back())) { close(fd); clients.pop_back(); }
+				}
+			}
+		}
+	}
+};
+
+// Client of conf_daemon with cache of answers: cache is dropped when
+// daemon pushes new generation, pushes are taken without waiting on
+// every get(), so cached lookup is one recv() which finds nothing
+class conf_client {
+public:
+	conf_client() {}
+	conf_client(const conf_client &) = delete;
+	conf_client &operator=(const conf_client &) = delete;
+	~conf_client() { disconnect(); }
+
+	// connect to daemon on socket_path
+	// return 0 on success or some error code
+	int connect(const std::string &socket_path) {
+		disconnect();
+		struct sockaddr_un addr;
+		if (!conf_unix_addr(socket_path, &addr)) return CONFERR_ERRFILE;
+		fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (fd < 0) return CONFERR_ERRFILE;
+		if (::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0) {
+			disconnect();
+			return CONFERR_ERRFILE;
+		}
+		return 0;
+	}
+
+	void disconnect() {
+		if (fd >= 0) close(fd);
+		fd = -1;
+		in.clear();
+		cache.clear();
+		cache_gen = 0;
+	}
+
+	// turn client cache off (every get() asks daemon)
+	void use_cache(bool on) { caching = on; if (!on) cache.clear(); }
+
+	// value of option key into *value, keys longer than
+	// CONF_DAEMON_MAX_KEY are not served
+	// return 0 if found, CONFERR_WRONGPARAM if there is no such option
+	// or some error code
+	int get(std::string_view key, std::string *value) {
+		if (fd < 0) return CONFERR_ERRFILE;
+		if (key.size() > CONF_DAEMON_MAX_KEY) return CONFERR_WRONGPARAM;
+		if (caching) {
+			if (!read_frames(false)) return CONFERR_ERRFILE;
+			auto it = cache.find(std::string(key));
+			if (it != cache.end()) {
+				if (!it->second.first) return CONFERR_WRONGPARAM;
+				if (value) *value = it->second.second;
+				return 0;
+			}
+		}
+
+		std::string req;
+		req.push_back(CONF_OP_GET);
+		conf_put<uint32_t>(&req, key.size());
+		req.append(key);
+		for (size_t done = 0; done < req.size(); ) {
+			ssize_t n = send(fd, req.data() + done, req.size() - done, MSG_NOSIGNAL);
+			if (n < 0) {
+				if (errno == EINTR) continue;
+				return CONFERR_ERRFILE;
+			}
+			done += n;
+		}
+
+		answered = false;
+		while (!answered)
+			if (!read_frames(true)) return CONFERR_ERRFILE;
+
+		// push of newer generation may come right after answer
+		if (caching && answer_gen == cache_gen) cache[std::string(key)] = { answer_found, answer };
+		if (!answer_found) return CONFERR_WRONGPARAM;
+		if (value) *value = answer;
+		return 0;
+	}
+
+	// last generation known from daemon
+	uint64_t generation() const { return cache_gen; }
+
+private:
+	int fd = -1;
+	std::string in;
+	bool caching = true;
+	uint64_t cache_gen = 0;
+	std::unordered_map<std::string, std::pair<bool, std::string>> cache;
+	bool answered = false;
+	bool answer_found = false;
+	uint64_t answer_gen = 0;
+	std::string answer;
+
+	void see_gen(uint64_t g) {
+		if (g != cache_gen) {
+			cache.clear();
+			cache_gen = g;
+		}
+	}
+
+	// receive (wait if block) and handle complete frames
+	// return false if connection is broken
+	bool read_frames(bool block) {
+		char buf[65536];
+		ssize_t n = recv(fd, buf, sizeof(buf), block ? 0 : MSG_DONTWAIT);
+		if (n == 0) return false;
+		if (n < 0) return errno == EINTR || (!block && (errno == EAGAIN || errno == EWOULDBLOCK));
+		in.append(buf, n);
+
+		size_t pos = 0;
+		for (;;) {
+			const char *p = in.data() + pos;
+			size_t left = in.size() - pos;
+			if (left >= 9 && p[0] == CONF_OP_GEN) {
+				see_gen(conf_take<uint64_t>(p + 1));
+				pos += 9;
+			} else if (left >= 14 && p[0] == CONF_OP_VALUE) {
+				uint32_t len = conf_take<uint32_t>(p + 10);
+				if (left < 14 + len) break;
+				answer_gen = conf_take<uint64_t>(p + 2);
+				see_gen(answer_gen);
+				answer_found = p[1] != 0;
+				answer.assign(p + 14, len);
+				answered = true;
+				pos += 14 + len;
+			} else if (left && p[0] != CONF_OP_GEN && p[0] != CONF_OP_VALUE) {
+				return false;
+			} else {
+				break;
+			}
+		}
+		in.erase(0, pos);
+		return true;
+	}
+};
+
+/*
+// Example of usage
+// daemon process
+int main() {
+	conf_daemon daemon("test.conf", "/run/myapp/conf.sock");
+	if (daemon.start() != 0) return -1;
+	for (;;) { // reload on SIGHUP
+		pause();
+		daemon.reload();
+	}
+}
+
+// client process
+conf_client conf;
+if (conf.connect("/run/myapp/conf.sock") != 0) return -1;
+std::string host;
+if (conf.get("host", &host) != 0) host = "localhost";
+*/
+
+#endif /* CPP_PARSE_CONFIG_DAEMON_H */
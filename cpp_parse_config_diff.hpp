@@ -0,0 +1,438 @@
+/*
+* cpp_parse_config_diff.hpp
+*
+* Changes between generations of config for cpp_parse_config.hpp:
+* incremental reparse which scans again only changed part of config
+* text and reports added, removed and changed options; subscriptions of
+* callbacks to changes of single options or groups of them.
+*
+* Licensed under GNU General Public License v3
+*
+* Author: Kuzin Andrey <kuzinandrey@yandex.ru>
+* (c) 2021
+*/
+#ifndef CPP_PARSE_CONFIG_DIFF_H
+#define CPP_PARSE_CONFIG_DIFF_H
+
+#include "cpp_parse_config.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <sstream>
+
+// Change of one option between two generations of config
+struct conf_change {
+	enum change_kind {
+		added
+		, removed
+		, changed
+	};
+
+	change_kind kind;
+	std::string name;
+	std::string old_value; // for removed and changed
+	std::string value; // for added and changed
+};
+
+typedef std::vector<conf_change> conf_diff;
+
+// Put into *diff changes of options from old to now
+inline void conf_compute_diff(const std::unordered_map<std::string,std::string> &old,
+	const std::unordered_map<std::string,std::string> &now, conf_diff *diff)
+{
+	diff->clear();
+	for (auto &o : old) {
+		auto it = now.find(o.first);
+		if (it == now.end())
+			diff->push_back({ conf_change::removed, o.first, o.second, std::string() });
+		else if (it->second != o.second)
+			diff->push_back({ conf_change::changed, o.first, o.second, it->second });
+	}
+	for (auto &n : now) {
+		if (!old.count(n.first))
+			diff->push_back({ conf_change::added, n.first, std::string(), n.second });
+	}
+} // conf_compute_diff()
+
+// Callbacks subscribed to changes of option name or of all options
+// with name prefix. dispatch() calls every affected callback once with
+// only its part of diff, callbacks of untouched options are not called.
+class conf_subscriptions {
+public:
+	typedef std::function<void(const conf_diff &)> change_fn;
+
+	// call fn on changes of option name
+	// return id for unsubscribe()
+	int subscribe(const std::string &name, change_fn fn) {
+		return add(name, false, fn);
+	}
+
+	// call fn on changes of options which names begin with prefix
+	// return id for unsubscribe()
+	int subscribe_prefix(const std::string &prefix, change_fn fn) {
+		return add(prefix, true, fn);
+	}
+
+	void unsubscribe(int id) {
+		std::lock_guard<std::mutex> lock(mutex);
+		for (size_t i = 0; i < subs.size(); i++) {
+			if (subs[i].id != id) continue;
+			subs.erase(subs.begin() + i);
+			reindex();
+			return;
+		}
+	}
+
+	bool empty() const {
+		std::lock_guard<std::mutex> lock(mutex);
+		return subs.empty();
+	}
+
+	// call callbacks affected by diff (callbacks may (un)subscribe)
+	void dispatch(const conf_diff &diff) {
+		std::vector<std::pair<change_fn, conf_diff>> calls;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			std::vector<int> slot(subs.size(), -1); // index in calls
+			auto hit = [&](const std::vector<size_t> &list, const conf_change &c) {
+				for (size_t i : list) {
+					if (slot[i] < 0) {
+						slot[i] = calls.size();
+						calls.emplace_back(subs[i].fn, conf_diff());
+					}
+					calls[slot[i]].second.push_back(c);
+				}
+			};
+			for (const conf_change &c : diff) {
+				auto it = by_name.find(c.name);
+				if (it != by_name.end()) hit(it->second, c);
+				for (size_t len : prefix_lengths) {
+					if (len > c.name.size()) break;
+					auto pit = by_prefix.find(c.name.substr(0, len));
+					if (pit != by_prefix.end()) hit(pit->second, c);
+				}
+			}
+		}
+		for (auto &call : calls) call.first(call.second);
+	}
+
+	// compute diff between generations once and dispatch() it
+	void dispatch(const std::unordered_map<std::string,std::string> &old,
+		const std::unordered_map<std::string,std::string> &now)
+	{
+		if (empty()) return;
+		conf_diff diff;
+		conf_compute_diff(old, now, &diff);
+		if (!diff.empty()) dispatch(diff);
+	}
+
+private:
+	struct subscription {
+		int id;
+		std::string key;
+		bool prefix;
+		change_fn fn;
+	};
+
+	mutable std::mutex mutex;
+	std::vector<subscription> subs;
+	int next_id = 1;
+	// indexes of subs by exact name and by prefix
+	std::unordered_map<std::string, std::vector<size_t>> by_name;
+	std::unordered_map<std::string, std::vector<size_t>> by_prefix;
+	std::vector<size_t> prefix_lengths; // sorted, unique
+
+	int add(const std::string &key, bool prefix, change_fn fn) {
+		std::lock_guard<std::mutex> lock(mutex);
+		int id = next_id++;
+		subs.push_back({ id, key, prefix, fn });
+		reindex();
+		return id;
+	}
+
+	void reindex() {
+		by_name.clear();
+		by_prefix.clear();
+		prefix_lengths.clear();
+		for (size_t i = 0; i < subs.size(); i++) {
+			if (subs[i].prefix) {
+				by_prefix[subs[i].key].push_back(i);
+				prefix_lengths.push_back(subs[i].key.size());
+			} else {
+				by_name[subs[i].key].push_back(i);
+			}
+		}
+		std::sort(prefix_lengths.begin(), prefix_lengths.end());
+		prefix_lengths.erase(std::unique(prefix_lengths.begin(), prefix_lengths.end()), prefix_lengths.end());
+	}
+};
+
+// Config which is parsed again incrementally: it keeps text of previous
+// generation with offsets of all options and on update() finds changed
+// byte range (common prefix and suffix), parses again only from the last
+// option starting before the change until the first unchanged option
+// after it, and patches options map and list in place.
+class conf_incremental {
+public:
+	typedef std::unordered_map<std::string,std::string> map_type;
+
+	conf_incremental() {}
+
+	// options of current generation, first option with the same name wins
+	const map_type &values() const { return map; }
+
+	// bytes scanned by the last update()
+	size_t rescanned() const { return last_scanned; }
+
+	// set new config text, put changes against previous generation
+	// into *diff if given (everything is added on first call), on error
+	// previous generation is kept
+	// return 0 on success or some error code
+	int update(std::string fresh, conf_diff *diff = nullptr) {
+		if (diff) diff->clear();
+
+		// changed window: [a, text.size() - s) in old, [a, fresh.size() - s) in fresh
+		size_t a = 0;
+		size_t s = 0;
+		if (loaded) {
+			size_t min_len = std::min(text.size(), fresh.size());
+			const char *o = text.data();
+			const char *n = fresh.data();
+			// memcmp by blocks finds the block with first difference fast
+			while (a + conf_cmp_block <= min_len && !std::memcmp(o + a, n + a, conf_cmp_block))
+				a += conf_cmp_block;
+			while (a < min_len && o[a] == n[a]) a++;
+			if (a == text.size() && a == fresh.size()) { last_scanned = 0; return 0; }
+
+			const char *oe = o + text.size();
+			const char *ne = n + fresh.size();
+			while (s + conf_cmp_block <= min_len - a
+				&& !std::memcmp(oe - s - conf_cmp_block, ne - s - conf_cmp_block, conf_cmp_block))
+			{
+				s += conf_cmp_block;
+			}
+			while (s < min_len - a && oe[-1 - (std::ptrdiff_t)s] == ne[-1 - (std::ptrdiff_t)s]) s++;
+		}
+		std::ptrdiff_t delta = static_cast<std::ptrdiff_t>(fresh.size()) - static_cast<std::ptrdiff_t>(text.size());
+
+		// restart at the last option which begins before the change
+		size_t k0 = 0;
+		size_t restart = 0;
+		int restart_line = 1;
+		if (loaded) {
+			auto it = std::upper_bound(entries.begin(), entries.end(), a,
+				[](size_t pos, const entry &e) { return pos < e.begin; });
+			if (it != entries.begin()) {
+				--it;
+				k0 = it - entries.begin();
+				restart = it->begin;
+				restart_line = it->line;
+			}
+		}
+
+		incremental_sink sink;
+		sink.self = this;
+		sink.data = fresh.data();
+		sink.sync_from = fresh.size() - s;
+		sink.delta = delta;
+		sink.line_pos = restart;
+		sink.line = restart_line;
+
+		conf_parser st;
+		st.line = restart_line;
+		st.offset = restart;
+		st.line_offset = restart;
+		while (st.line_offset && fresh[st.line_offset - 1] != '\n') st.line_offset--;
+		const char *end = fresh.data() + fresh.size();
+		static const std::string source_name = "<incremental>";
+		int err = conf_parse_block(&st, fresh.data() + restart, end, source_name, sink);
+		if (err == conf_stop) {
+			err = 0;
+		} else if (!err) {
+			err = conf_parse_finish(&st, end, sink);
+			if (err == conf_stop) err = 0;
+		}
+		if (err) return err;
+		last_scanned = (sink.synced ? sink.sync_pos : fresh.size()) - restart;
+
+		// old options [k0, k_sync) are replaced by sink.fresh_entries
+		size_t k_sync = sink.synced ? sink.sync_index : entries.size();
+		apply(fresh, k0, k_sync, sink, diff);
+		loaded = true;
+		return 0;
+	}
+
+	// read file file_name and update() from it
+	// return 0 on success or some error code
+	int update_file(const std::string &file_name, conf_diff *diff = nullptr) {
+		std::ifstream fconf(file_name, std::ios::binary);
+		if (!fconf) return CONFERR_ERRFILE;
+		std::ostringstream ss;
+		ss << fconf.rdbuf();
+		return update(ss.str(), diff);
+	}
+
+private:
+	// option position in text, name begins from begin
+	struct entry {
+		size_t begin;
+		size_t name_len;
+		size_t value_off;
+		size_t value_len;
+		int line;
+	};
+
+	// code returned by sink to stop parsing on unchanged option
+	static const int conf_stop = 1;
+	// bytes compared at once looking for changed range
+	static const size_t conf_cmp_block = 256;
+
+	struct incremental_sink {
+		conf_incremental *self;
+		const char *data;
+		size_t sync_from; // first byte of unchanged suffix in fresh text
+		std::ptrdiff_t delta;
+		size_t line_pos; // line of byte data[line_pos] is line
+		int line;
+		std::vector<entry> fresh_entries;
+		bool synced = false;
+		size_t sync_pos = 0;
+		size_t sync_index = 0;
+		int line_shift = 0; // line change of unchanged tail
+
+		int operator()(std::string_view name, std::string_view value) {
+			size_t begin = name.data() - data;
+			const char *p = data + line_pos;
+			const char *stop = data + begin;
+			while ((p = static_cast<const char *>(std::memchr(p, '\n', stop - p)))) { line++; p++; }
+			line_pos = begin;
+
+			if (begin >= sync_from) {
+				// the same option in old text: the rest of text parses the same way
+				size_t old_begin = begin - delta;
+				auto it = std::lower_bound(self->entries.begin(), self->entries.end(), old_begin,
+					[](const entry &e, size_t pos) { return e.begin < pos; });
+				if (it != self->entries.end() && it->begin == old_begin) {
+					synced = true;
+					sync_pos = begin;
+					sync_index = it - self->entries.begin();
+					line_shift = line - it->line;
+					return conf_stop;
+				}
+			}
+
+			entry e;
+			e.begin = begin;
+			e.name_len = name.size();
+			e.value_off = value.data() ? value.data() - data : begin;
+			e.value_len = value.size();
+			e.line = line;
+			fresh_entries.push_back(e);
+			return 0;
+		}
+	};
+
+	std::string text;
+	bool loaded = false;
+	std::vector<entry> entries; // in text order
+	map_type map;
+	std::unordered_map<std::string, size_t> counts; // occurrences of every name
+	size_t last_scanned = 0;
+
+	static std::string_view name_of(const std::string &t, const entry &e) {
+		return std::string_view(t.data() + e.begin, e.name_len);
+	}
+	static std::string_view value_of(const std::string &t, const entry &e) {
+		return std::string_view(t.data() + e.value_off, e.value_len);
+	}
+
+	void apply(std::string &fresh, size_t k0, size_t k_sync, incremental_sink &sink, conf_diff *diff) {
+		// names touched by the change and their occurrences removed/added
+		struct touch {
+			size_t removed = 0;
+			size_t added = 0;
+			const entry *first = nullptr; // first added occurrence
+		};
+		std::unordered_map<std::string, touch> touched;
+		for (size_t k = k0; k < k_sync; k++)
+			touched[std::string(name_of(text, entries[k]))].removed++;
+		for (const entry &e : sink.fresh_entries) {
+			touch &t = touched[std::string(name_of(fresh, e))];
+			if (!t.added++) t.first = &e;
+		}
+
+		// patch list of options, unchanged tail is only shifted
+		entries.erase(entries.begin() + k0, entries.begin() + k_sync);
+		entries.insert(entries.begin() + k0, sink.fresh_entries.begin(), sink.fresh_entries.end());
+		if (sink.delta || sink.line_shift) {
+			for (size_t k = k0 + sink.fresh_entries.size(); k < entries.size(); k++) {
+				entries[k].begin += sink.delta;
+				entries[k].value_off += sink.delta;
+				entries[k].line += sink.line_shift;
+			}
+		}
+		text.swap(fresh);
+
+		for (auto &t : touched) {
+			const std::string &name = t.first;
+			size_t old_count = counts[name];
+			size_t new_count = old_count - t.second.removed + t.second.added;
+
+			auto cur = map.find(name);
+			bool had = cur != map.end();
+
+			if (!new_count) {
+				counts.erase(name);
+				if (had) {
+					if (diff) diff->push_back({ conf_change::removed, name, cur->second, std::string() });
+					map.erase(cur);
+				}
+				continue;
+			}
+			counts[name] = new_count;
+
+			// first occurrence wins: usually it is added one, else find it
+			std::string_view value;
+			if (old_count == t.second.removed) {
+				value = value_of(text, *t.second.first);
+			} else {
+				for (const entry &e : entries)
+					if (name_of(text, e) == name) { value = value_of(text, e); break; }
+			}
+
+			if (!had) {
+				if (diff) diff->push_back({ conf_change::added, name, std::string(), std::string(value) });
+				map.emplace(name, value);
+			} else if (cur->second != value) {
+				if (diff) diff->push_back({ conf_change::changed, name, cur->second, std::string(value) });
+				cur->second.assign(value);
+			}
+		}
+	}
+};
+
+/*
+// Example of usage
+int main() {
+	conf_incremental conf;
+	conf_diff diff;
+	if (conf.update_file("test.conf", &diff) != 0) return -1;
+	...
+	// file is changed: only changed lines are parsed again
+	if (conf.update_file("test.conf", &diff) == 0) {
+		for (auto &c : diff) {
+			if (c.kind == conf_change::changed)
+				std::cout << c.name << ": " << c.old_value << " -> " << c.value << std::endl;
+		}
+	}
+
+	// or let only interested subsystems know
+	conf_subscriptions subs;
+	subs.subscribe("log_level", [](const conf_diff &d) { set_log_level(d[0].value); });
+	subs.subscribe_prefix("db_", [](const conf_diff &) { reconnect_db_pool(); });
+	if (conf.update_file("test.conf", &diff) == 0) subs.dispatch(diff);
+}
+*/
+
+#endif /* CPP_PARSE_CONFIG_DIFF_H */
@@ -0,0 +1,263 @@
+/*
+* cpp_parse_config_parallel.hpp
+*
+* Multi-threaded parsing of very large config files for
+* cpp_parse_config.hpp. Input is split into chunks at line begins,
+* every chunk is parsed speculatively on its own thread and results
+* are merged in file order, so the first option with the same name
+* still wins. Batch loading of many small config files on a bounded
+* pool of workers.
+*
+* Licensed under GNU General Public License v3
+*
+* Author: Kuzin Andrey <kuzinandrey@yandex.ru>
+* (c) 2021
+*/
+#ifndef CPP_PARSE_CONFIG_PARALLEL_H
+#define CPP_PARSE_CONFIG_PARALLEL_H
+
+#include "cpp_parse_config.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <thread>
+
+#ifndef CONF_PARALLEL_MIN_CHUNK
+#define CONF_PARALLEL_MIN_CHUNK (1 << 20) // smaller chunks are not worth a thread
+#endif
+
+// Number of threads when caller passes 0
+inline unsigned conf_default_threads() {
+	unsigned n = std::thread::hardware_concurrency();
+	return n ? n : 1;
+} // conf_default_threads()
+
+// Call fn(i) for every i in [0, count) on up to threads threads, calling
+// thread works too, next index is taken by the first free thread
+template <class Fn>
+inline void conf_run_parallel(size_t count, unsigned threads, Fn &fn) {
+	if (threads > count) threads = count;
+	if (threads < 1) threads = 1;
+
+	std::atomic<size_t> next{0};
+	auto work = [&]() {
+		for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < count; ) fn(i);
+	};
+	std::vector<std::thread> pool;
+	for (unsigned t = 1; t < threads; t++) pool.emplace_back(work);
+	work();
+	for (auto &th : pool) th.join();
+} // conf_run_parallel()
+
+// Part of input parsed by one thread
+struct conf_chunk {
+	const char *begin = nullptr;
+	const char *end = nullptr;
+	conf_parser st; // parser state at chunk end
+	int err = 0;
+	std::unordered_map<std::string,std::string> values;
+};
+
+// Parse config in memory [data, data + size) on threads threads (0 - one
+// per CPU) and fill the unordered_map of strings "option"=>"value".
+// Chunk is parsed as if it begins outside of any option. That is checked
+// in file order afterwards: when previous chunk ends inside an option
+// (quoted value with new lines, name waiting for '='), the chunk is
+// parsed again from real state. Chunk maps are spliced into result
+// with unordered_map::merge(), which keeps the first option.
+// return 0 on success or some error code
+inline int parse_config_parallel_buffer(const char *data, size_t size,
+	std::unordered_map<std::string,std::string> *ret, unsigned threads = 0,
+	const std::string &buffer_name = conf_buffer_name)
+{
+	if (!ret) return CONFERR_NORET;
+	if (!data && size) return CONFERR_ERRFILE;
+	if (!threads) threads = conf_default_threads();
+
+	size_t count = std::min<size_t>(threads, size / CONF_PARALLEL_MIN_CHUNK);
+	if (count < 2) {
+		ret->clear();
+		conf_map_sink sink = { ret };
+		int err = conf_parse_all(data, size, buffer_name, sink);
+		if (err) ret->clear();
+		return err;
+	}
+
+	// chunk borders go right after new lines
+	std::vector<conf_chunk> chunks(count);
+	const char *end = data + size;
+	const char *p = data;
+	for (size_t i = 0; i < count; i++) {
+		chunks[i].begin = p;
+		if (i + 1 < count) {
+			const char *target = std::max(p, data + size / count * (i + 1));
+			const char *nl = static_cast<const char *>(std::memchr(target, '\n', end - target));
+			p = nl ? nl + 1 : end;
+		} else {
+			p = end;
+		}
+		chunks[i].end = p;
+	}
+
+	auto parse_chunk = [&](size_t i) {
+		conf_chunk &c = chunks[i];
+		c.st.quiet = true; // errors may be caused by wrong guess of start state
+		c.st.offset = c.st.line_offset = c.begin - data; // chunk begins a line
+		conf_map_sink sink = { &c.values };
+		c.err = conf_parse_block(&c.st, c.begin, c.end, buffer_name, sink);
+	};
+	conf_run_parallel(count, threads, parse_chunk);
+
+	// fix-up in file order: st is real parser state at chunk begin
+	conf_parser st;
+	size_t total = 0;
+	for (const conf_chunk &c : chunks) total += c.values.size();
+	ret->clear();
+
+	for (size_t i = 0; i < count; i++) {
+		conf_chunk &c = chunks[i];
+		if (st.mode == conf_parser::parse_skip_space && !c.err) {
+			int line = st.line;
+			st = c.st;
+			st.line += line - 1;
+			st.quiet = false;
+		} else {
+			c.values.clear();
+			conf_map_sink sink = { &c.values };
+			int err = conf_parse_block(&st, c.begin, c.end, buffer_name, sink);
+			if (err) { ret->clear(); return err; }
+		}
+
+		if (i == 0) {
+			*ret = std::move(c.values);
+			ret->reserve(total);
+		} else {
+			ret->merge(c.values);
+		}
+	}
+
+	conf_map_sink sink = { ret };
+	int err = conf_parse_finish(&st, end, sink);
+	if (err) ret->clear();
+	return err;
+} // parse_config_parallel_buffer()
+
+// Parse config file file_name on threads threads (0 - one per CPU), see
+// parse_config_parallel_buffer()
+// return 0 on success or some error code
+inline int parse_config_parallel(std::string file_name,
+	std::unordered_map<std::string,std::string> *ret, unsigned threads = 0)
+{
+	if (!ret) return CONFERR_NORET;
+#ifdef CONF_HAVE_MMAP
+	conf_mapping m;
+	int err = conf_map_file(file_name, &m, MADV_WILLNEED);
+	if (err) return err;
+	if (!m.addr) { ret->clear(); return 0; }
+
+	err = parse_config_parallel_buffer(static_cast<const char *>(m.addr), m.size, ret, threads, file_name);
+	munmap(m.addr, m.size);
+	return err;
+#else
+	std::ifstream fconf(file_name, std::ios::binary);
+	if (!fconf) return CONFERR_ERRFILE;
+	std::string buf((std::istreambuf_iterator<char>(fconf)), std::istreambuf_iterator<char>());
+	return parse_config_parallel_buffer(buf.data(), buf.size(), ret, threads, file_name);
+#endif
+} // parse_config_parallel()
+
+// Read the whole file file_name into *buf (its memory is reused)
+// return 0 on success or some error code
+inline int conf_read_file(const std::string &file_name, std::string *buf) {
+#ifdef CONF_HAVE_MMAP
+	int fd = open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) return CONFERR_ERRFILE;
+
+	struct stat sb;
+	if (fstat(fd, &sb) != 0) { close(fd); return CONFERR_ERRFILE; }
+
+	// one byte more than size: short read of regular file is its end
+	buf->resize(static_cast<size_t>(sb.st_size) + 1);
+	size_t got = 0;
+	for (;;) {
+		if (got == buf->size()) buf->resize(got + CONF_READ_BLOCK_SIZE);
+		size_t want = buf->size() - got;
+		ssize_t n = ::read(fd, &(*buf)[got], want);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			close(fd);
+			return CONFERR_ERRFILE;
+		}
+		got += n;
+		if (n == 0 || (S_ISREG(sb.st_mode) && static_cast<size_t>(n) < want)) break;
+	}
+	close(fd);
+	buf->resize(got);
+	return 0;
+#else
+	std::ifstream fconf(file_name, std::ios::binary);
+	if (!fconf) return CONFERR_ERRFILE;
+	buf->assign((std::istreambuf_iterator<char>(fconf)), std::istreambuf_iterator<char>());
+	return 0;
+#endif
+} // conf_read_file()
+
+// Result of one file of parse_config_batch()
+struct conf_file_result {
+	int err = 0; // 0 or error code of this file
+	std::unordered_map<std::string,std::string> values;
+};
+
+// Parse every file of files on threads workers (0 - one per CPU), file
+// is read at once into buffer of worker and parsed from memory, so
+// reads of different files overlap. (*results)[i] is result of files[i].
+// Errors go to the error handler of calling thread (one call at a time,
+// order of files is not kept).
+// return 0 if all files are parsed or error code of the first failed file
+inline int parse_config_batch(const std::vector<std::string> &files,
+	std::vector<conf_file_result> *results, unsigned threads = 0)
+{
+	if (!results) return CONFERR_NORET;
+	if (!threads) threads = conf_default_threads();
+
+	results->clear();
+	results->resize(files.size());
+
+	conf_error_relay relay;
+	relay.to = conf_thread_error_handler();
+	auto parse_file = [&](size_t i) {
+		static thread_local std::string buf;
+		conf_file_result &r = (*results)[i];
+		r.err = conf_read_file(files[i], &buf);
+		if (r.err) return;
+		conf_map_sink sink = { &r.values };
+		conf_error_handler saved = conf_thread_error_handler();
+		relay.install();
+		r.err = conf_parse_all(buf.data(), buf.size(), files[i], sink);
+		conf_thread_error_handler() = saved;
+		if (r.err) r.values.clear();
+	};
+	conf_run_parallel(files.size(), threads, parse_file);
+
+	for (const conf_file_result &r : *results)
+		if (r.err) return r.err;
+	return 0;
+} // parse_config_batch()
+
+/*
+// Example of usage
+int main() {
+	std::unordered_map<std::string,std::string> flags;
+	if (parse_config_parallel("feature_flags.conf", &flags, 8) != 0) return -1;
+	...
+
+	std::vector<std::string> files = { "tenant1.conf", "tenant2.conf", ... };
+	std::vector<conf_file_result> tenants;
+	if (parse_config_batch(files, &tenants, 16) != 0) {
+		for (size_t i = 0; i < files.size(); i++)
+			if (tenants[i].err) std::cerr << "Can't load " << files[i] << std::endl;
+	}
+}
+*/
+
+#endif /* CPP_PARSE_CONFIG_PARALLEL_H */
@@ -0,0 +1,133 @@
+/*
+* cpp_parse_config_rcu.hpp
+*
+* RCU-style holder of current parsed config for read-mostly access
+* from many threads. Readers are wait-free: they don't take locks and
+* don't write shared cache lines except own counter stripe. Writer
+* publishes new generation and frees the old one only after every
+* reader which could see it has left its read section.
+*
+* Licensed under GNU General Public License v3
+*
+* Author: Kuzin Andrey <kuzinandrey@yandex.ru>
+* (c) 2021
+*/
+#ifndef CPP_PARSE_CONFIG_RCU_H
+#define CPP_PARSE_CONFIG_RCU_H
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#ifndef CONF_RCU_STRIPES
+#define CONF_RCU_STRIPES 64 // number of reader counter stripes (cache lines)
+#endif
+
+#ifndef CONF_CACHE_LINE
+#define CONF_CACHE_LINE 64
+#endif
+
+// Holder of current generation of T with epoch based reclamation.
+// Readers count themselves in the counter of current epoch parity in
+// one of CONF_RCU_STRIPES stripes (chosen per thread), so reader threads
+// rarely share a cache line. Writer swaps pointer, then twice flips epoch
+// and waits for readers of previous parity to leave, after that no reader
+// can hold the old pointer and it is deleted.
+template <class T>
+class conf_rcu {
+public:
+	explicit conf_rcu(T *init = nullptr) : ptr(init) {}
+	conf_rcu(const conf_rcu &) = delete;
+	conf_rcu &operator=(const conf_rcu &) = delete;
+	~conf_rcu() { delete ptr.load(); }
+
+	// Read section: object pointer is valid while reader is alive,
+	// don't keep it longer than a request (writer waits for it)
+	class reader {
+	public:
+		reader(const reader &) = delete;
+		reader &operator=(const reader &) = delete;
+		reader(reader &&other) : counter(other.counter), p(other.p) { other.counter = nullptr; }
+		~reader() { if (counter) counter->fetch_sub(1, std::memory_order_release); }
+
+		const T *get() const { return p; }
+		const T *operator->() const { return p; }
+		const T &operator*() const { return *p; }
+		explicit operator bool() const { return p != nullptr; }
+
+	private:
+		friend class conf_rcu;
+		reader(std::atomic<long> *counter, const T *p) : counter(counter), p(p) {}
+		std::atomic<long> *counter;
+		const T *p;
+	};
+
+	// enter read section, wait-free
+	reader read() const {
+		stripe &s = stripes[stripe_index()];
+		unsigned long e = epoch.load(std::memory_order_seq_cst);
+		std::atomic<long> *counter = &s.count[e & 1];
+		counter->fetch_add(1, std::memory_order_seq_cst);
+		return reader(counter, ptr.load(std::memory_order_seq_cst));
+	}
+
+	// publish fresh generation, wait until no reader holds the old one
+	// and delete it (call from writer thread, never inside read section)
+	void update(T *fresh) {
+		std::lock_guard<std::mutex> lock(writer_mutex);
+		T *old = ptr.exchange(fresh, std::memory_order_seq_cst);
+		synchronize();
+		delete old;
+	}
+
+private:
+	struct alignas(CONF_CACHE_LINE) stripe {
+		std::atomic<long> count[2] = { {0}, {0} };
+	};
+
+	std::atomic<T *> ptr;
+	mutable std::atomic<unsigned long> epoch{0};
+	mutable stripe stripes[CONF_RCU_STRIPES];
+	std::mutex writer_mutex;
+
+	static unsigned stripe_index() {
+		static std::atomic<unsigned> next{0};
+		static thread_local unsigned idx = next.fetch_add(1, std::memory_order_relaxed) % CONF_RCU_STRIPES;
+		return idx;
+	}
+
+	// wait for all readers which entered before this call
+	void synchronize() {
+		// reader may take epoch before one flip and count itself after it,
+		// two flips cover both parities
+		for (int phase = 0; phase < 2; phase++) {
+			unsigned long e = epoch.fetch_add(1, std::memory_order_seq_cst);
+			for (;;) {
+				long sum = 0;
+				for (int i = 0; i < CONF_RCU_STRIPES; i++)
+					sum += stripes[i].count[e & 1].load(std::memory_order_acquire);
+				if (!sum) break;
+				std::this_thread::yield();
+			}
+		}
+	}
+};
+
+/*
+// Example of usage
+conf_rcu<std::unordered_map<std::string,std::string>> config;
+
+// worker thread, per request
+{
+	auto conf = config.read();
+	auto it = conf->find("log_level");
+	...
+} // read section ends here
+
+// reload thread
+auto fresh = new std::unordered_map<std::string,std::string>;
+if (parse_config("test.conf", fresh) == 0) config.update(fresh);
+else delete fresh;
+*/
+
+#endif /* CPP_PARSE_CONFIG_RCU_H */
@@ -0,0 +1,280 @@
+/*
+* cpp_parse_config_shm.hpp
+*
+* Config snapshot in POSIX shared memory for cpp_parse_config.hpp:
+* one publisher process parses config and publishes it, many worker
+* processes map it read-only and look options up in place without
+* locks and without own copies of options.
+*
+* Snapshot is the image of cpp_parse_config_cache.hpp (offsets only,
+* so it works at any mapping address). Every generation is its own
+* shared memory object "<name>.<generation>", small control object
+* "<name>" holds number of the current one. Publisher writes new
+* object, switches generation and unlinks old object; workers which
+* still map it keep using it until their next refresh(). Snapshot stays
+* published after publisher exits, restarted publisher goes on with
+* the next generation; remove() takes it down for good.
+*
+* Licensed under GNU General Public License v3
+*
+* Author: Kuzin Andrey <kuzinandrey@yandex.ru>
+* (c) 2021
+*/
+#ifndef CPP_PARSE_CONFIG_SHM_H
+#define CPP_PARSE_CONFIG_SHM_H
+
+#include "cpp_parse_config.hpp"
+#include "cpp_parse_config_cache.hpp"
+
+#include <atomic>
+#include <cerrno>
+
+#define CONF_SHM_MAGIC "CONFSHM" // 8 bytes with terminating zero
+#define CONF_SHM_RETIRED UINT64_MAX // generation of removed control object
+
+// Control object of shared snapshot
+struct conf_shm_control {
+	char magic[8];
+	std::atomic<uint64_t> generation; // 0 - nothing is published yet, CONF_SHM_RETIRED - removed
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "generation is shared between processes");
+
+// name of shared memory object of generation gen
+inline std::string conf_shm_object_name(const std::string &name, uint64_t gen) {
+	return name + "." + std::to_string(gen);
+} // conf_shm_object_name()
+
+// Publisher of config snapshots, name is shared memory name ("/myapp.conf"),
+// mode is access mode of shared memory objects (snapshot holds values in
+// plain text, by default only the same user can read it)
+class conf_shm_publisher {
+public:
+	explicit conf_shm_publisher(std::string name, mode_t mode = 0600) : name(name), mode(mode) {}
+	conf_shm_publisher(const conf_shm_publisher &) = delete;
+	conf_shm_publisher &operator=(const conf_shm_publisher &) = delete;
+	// snapshot stays published for workers and restarted publisher
+	~conf_shm_publisher() {
+		if (control) munmap(control, sizeof(conf_shm_control));
+	}
+
+	// take snapshot down: workers see it retired and keep their mapped
+	// copy, next publish() starts a new control object
+	void remove() {
+		if (!control) {
+			if (create_control() != 0) return;
+		}
+		uint64_t gen = control->generation.exchange(CONF_SHM_RETIRED);
+		if (gen && gen != CONF_SHM_RETIRED) shm_unlink(conf_shm_object_name(name, gen).c_str());
+		munmap(control, sizeof(conf_shm_control));
+		control = nullptr;
+		shm_unlink(name.c_str());
+	}
+
+	// parse config file file_name and publish it
+	// return 0 on success or some error code
+	int publish(const std::string &file_name) {
+		conf_flat_map m;
+		int err = parse_config_flat(file_name, &m);
+		if (err) return err;
+		return publish(m);
+	}
+
+	// publish options of m
+	// return 0 on success or some error code
+	int publish(const conf_flat_map &m) {
+		if (!control) {
+			int err = create_control();
+			if (err) return err;
+		}
+
+		std::string image;
+		conf_cache_build(m, conf_cache_source(), 0, &image);
+
+		uint64_t old_gen = control->generation.load(std::memory_order_relaxed);
+		uint64_t gen = old_gen + 1;
+		std::string object_name = conf_shm_object_name(name, gen);
+		shm_unlink(object_name.c_str()); // left by crashed publisher
+		int fd = shm_open(object_name.c_str(), O_CREAT | O_EXCL | O_RDWR, mode);
+		if (fd < 0) return CONFERR_ERRFILE;
+		if (fchmod(fd, mode) != 0 || ftruncate(fd, image.size()) != 0) { // mode without umask
+			close(fd);
+			shm_unlink(object_name.c_str());
+			return CONFERR_ERRFILE;
+		}
+		for (size_t done = 0; done < image.size(); ) {
+			ssize_t n = pwrite(fd, image.data() + done, image.size() - done, done);
+			if (n <= 0) {
+				if (n < 0 && errno == EINTR) continue;
+				close(fd);
+				shm_unlink(object_name.c_str());
+				return CONFERR_ERRFILE;
+			}
+			done += n;
+		}
+		close(fd);
+
+		// object is complete before anybody can see its generation
+		control->generation.store(gen, std::memory_order_release);
+		if (old_gen) shm_unlink(conf_shm_object_name(name, old_gen).c_str());
+		return 0;
+	}
+
+	uint64_t generation() const {
+		return control ? control->generation.load(std::memory_order_acquire) : 0;
+	}
+
+private:
+	std::string name;
+	mode_t mode;
+	conf_shm_control *control = nullptr;
+
+	int create_control() {
+		int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, mode);
+		if (fd < 0) return CONFERR_ERRFILE;
+		if (fchmod(fd, mode) != 0 || ftruncate(fd, sizeof(conf_shm_control)) != 0) {
+			close(fd);
+			return CONFERR_ERRFILE;
+		}
+		void *p = mmap(NULL, sizeof(conf_shm_control), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+		if (p == MAP_FAILED) return CONFERR_ERRFILE;
+
+		control = static_cast<conf_shm_control *>(p);
+		// generation goes on after restarted publisher, workers see a change
+		if (std::memcmp(control->magic, CONF_SHM_MAGIC, sizeof(control->magic)) != 0
+			|| control->generation.load() == CONF_SHM_RETIRED)
+		{
+			control->generation.store(0);
+			std::memcpy(control->magic, CONF_SHM_MAGIC, sizeof(control->magic));
+		}
+		return 0;
+	}
+};
+
+// Worker side of shared snapshot: options are looked up in place in
+// read-only mapping, refresh() maps the new generation when there is one
+class conf_shm_reader {
+public:
+	explicit conf_shm_reader(std::string name) : name(name) {}
+	conf_shm_reader(const conf_shm_reader &) = delete;
+	conf_shm_reader &operator=(const conf_shm_reader &) = delete;
+	~conf_shm_reader() {
+		if (control) munmap(const_cast<conf_shm_control *>(control), sizeof(conf_shm_control));
+	}
+
+	// map current generation if it is changed, call between requests:
+	// views from find() of previous generation are invalid after it
+	// return 0 on success or some error code (previous snapshot is kept)
+	int refresh() {
+		if (!control) {
+			int err = open_control();
+			if (err) return err;
+		}
+
+		for (bool reopened = false;;) {
+			uint64_t gen = control->generation.load(std::memory_order_acquire);
+			if (gen == CONF_SHM_RETIRED) {
+				// publisher removed snapshot: pick up new control object
+				// if there is one already, else keep mapped snapshot
+				if (reopened || reopen_control() != 0) return CONFERR_ERRFILE;
+				reopened = true;
+				continue;
+			}
+			if (!gen) return CONFERR_ERRFILE;
+			if (gen == mapped_gen) return 0;
+
+			int fd = shm_open(conf_shm_object_name(name, gen).c_str(), O_RDONLY, 0);
+			if (fd < 0) {
+				// publisher switched to newer generation meanwhile
+				if (errno == ENOENT && control->generation.load(std::memory_order_acquire) != gen) continue;
+				return CONFERR_ERRFILE;
+			}
+			conf_cache fresh;
+			int err = conf_cache_map_fd(fd, &fresh);
+			close(fd);
+			if (err) return err;
+			snapshot = std::move(fresh);
+			mapped_gen = gen;
+			return 0;
+		}
+	}
+
+	// true if there is newer generation than mapped one
+	bool changed() const {
+		return control && control->generation.load(std::memory_order_acquire) != mapped_gen;
+	}
+
+	uint64_t generation() const { return mapped_gen; }
+
+	// options of mapped generation
+	const conf_cache &values() const { return snapshot; }
+	bool find(std::string_view key, std::string_view *value = nullptr) const { return snapshot.find(key, value); }
+	std::string_view get(std::string_view key, std::string_view def = std::string_view()) const { return snapshot.get(key, def); }
+
+private:
+	std::string name;
+	const conf_shm_control *control = nullptr;
+	ino_t control_ino = 0;
+	uint64_t mapped_gen = 0;
+	conf_cache snapshot;
+
+	// map control object again if it is replaced (other inode), new
+	// control object counts generations from the beginning
+	int reopen_control() {
+		struct stat sb;
+		int fd = shm_open(name.c_str(), O_RDONLY, 0);
+		if (fd < 0) return CONFERR_ERRFILE;
+		bool same = fstat(fd, &sb) != 0 || sb.st_ino == control_ino;
+		close(fd);
+		if (same) return CONFERR_ERRFILE;
+
+		const conf_shm_control *old = control;
+		control = nullptr;
+		int err = open_control();
+		if (err) { control = old; return err; }
+		munmap(const_cast<conf_shm_control *>(old), sizeof(conf_shm_control));
+		mapped_gen = 0;
+		return 0;
+	}
+
+	int open_control() {
+		int fd = shm_open(name.c_str(), O_RDONLY, 0);
+		if (fd < 0) return CONFERR_ERRFILE;
+		struct stat sb;
+		if (fstat(fd, &sb) != 0 || sb.st_size < static_cast<off_t>(sizeof(conf_shm_control))) {
+			close(fd);
+			return CONFERR_ERRFILE;
+		}
+		control_ino = sb.st_ino;
+		void *p = mmap(NULL, sizeof(conf_shm_control), PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if (p == MAP_FAILED) return CONFERR_ERRFILE;
+		control = static_cast<const conf_shm_control *>(p);
+		if (std::memcmp(control->magic, CONF_SHM_MAGIC, sizeof(control->magic)) != 0) {
+			munmap(p, sizeof(conf_shm_control));
+			control = nullptr;
+			return CONFERR_WRONGSYNTAX;
+		}
+		return 0;
+	}
+};
+
+/*
+// Example of usage (link with -lrt on old glibc)
+// master process
+conf_shm_publisher publisher("/myapp.conf");
+if (publisher.publish("test.conf") != 0) return -1;
+// fork workers, on SIGHUP: publisher.publish("test.conf");
+// on shutdown for good (not on restart): publisher.remove();
+
+// worker process
+conf_shm_reader conf("/myapp.conf");
+for (;;) { // serving loop
+	conf.refresh(); // cheap when generation is the same
+	std::string_view host = conf.get("host", "localhost");
+	...
+}
+*/
+
+#endif /* CPP_PARSE_CONFIG_SHM_H */
@@ -0,0 +1,260 @@
+/*
+* cpp_parse_config_tree.hpp
+*
+* Hierarchical config for cpp_parse_config.hpp: [section] headers and
+* dotted names ("db.replica.host"), options are kept in radix tree, so
+* all options under some prefix ("db.replica.") are found by walk of
+* one subtree instead of scan of all options.
+*
+* Config example:
+*   timeout = 10
+*   [db.primary]
+*   host = 10.0.0.1     # db.primary.host
+*   [db.replica]
+*   host = 10.0.0.2     # db.replica.host
+*   pool.size = 4       # db.replica.pool.size
+*
+* Licensed under GNU General Public License v3
+*
+* Author: Kuzin Andrey <kuzinandrey@yandex.ru>
+* (c) 2021
+*/
+#ifndef CPP_PARSE_CONFIG_TREE_H
+#define CPP_PARSE_CONFIG_TREE_H
+
+#include "cpp_parse_config.hpp"
+
+#include <algorithm>
+
+// Radix tree of options: edge labels and values are kept in one string
+// table as offsets, so split of edge on insert copies no bytes.
+// Children of node are sorted by first byte of label, walk goes in
+// name order. First option with the same name wins.
+class conf_tree {
+public:
+	conf_tree() { clear(); }
+
+	void clear() {
+		nodes.assign(1, node());
+		strings.clear();
+		count = 0;
+	}
+
+	size_t size() const { return count; }
+
+	// add option, return false if option with this name already exists
+	bool insert(std::string_view key, std::string_view value) {
+		uint32_t n = 0;
+		size_t i = 0;
+		for (;;) {
+			if (i == key.size()) {
+				if (nodes[n].has_value) return false;
+				set_value(n, value);
+				return true;
+			}
+
+			size_t pos;
+			if (!child(n, key[i], &pos)) {
+				uint32_t leaf = new_node(add_string(key.substr(i)), key.size() - i);
+				set_value(leaf, value);
+				nodes[n].children.insert(nodes[n].children.begin() + pos, leaf);
+				return true;
+			}
+
+			uint32_t c = nodes[n].children[pos];
+			std::string_view label = label_of(c);
+			size_t k = common_prefix(label, key.substr(i));
+			if (k < label.size()) {
+				// split edge: new node takes first k bytes of label
+				uint32_t mid = new_node(nodes[c].label_off, k);
+				nodes[c].label_off += k;
+				nodes[c].label_len -= k;
+				nodes[mid].children.push_back(c);
+				nodes[n].children[pos] = mid;
+				c = mid;
+			}
+			n = c;
+			i += k;
+		}
+	}
+
+	// find option key, return true and its value in *value if found
+	bool find(std::string_view key, std::string_view *value = nullptr) const {
+		uint32_t n = 0;
+		size_t i = 0;
+		while (i < key.size()) {
+			size_t pos;
+			if (!child(n, key[i], &pos)) return false;
+			uint32_t c = nodes[n].children[pos];
+			std::string_view label = label_of(c);
+			if (key.compare(i, label.size(), label) != 0) return false;
+			n = c;
+			i += label.size();
+		}
+		if (!nodes[n].has_value) return false;
+		if (value) *value = value_of(n);
+		return true;
+	}
+
+	// value of option key or def if not found
+	std::string_view get(std::string_view key, std::string_view def = std::string_view()) const {
+		std::string_view v;
+		return find(key, &v) ? v : def;
+	}
+
+	// call fn(std::string_view name, std::string_view value) for every
+	// option which name begins with prefix, in name order
+	template <class Fn>
+	void for_each(std::string_view prefix, Fn fn) const {
+		uint32_t n = 0;
+		size_t i = 0;
+		std::string name;
+		while (i < prefix.size()) {
+			size_t pos;
+			if (!child(n, prefix[i], &pos)) return;
+			uint32_t c = nodes[n].children[pos];
+			std::string_view label = label_of(c);
+			size_t k = common_prefix(label, prefix.substr(i));
+			if (k < label.size() && i + k < prefix.size()) return;
+			n = c;
+			i += k;
+			name.append(label); // prefix may end inside of label
+		}
+		walk(n, &name, fn);
+	}
+
+	// number of options which name begins with prefix
+	size_t count_prefix(std::string_view prefix) const {
+		size_t c = 0;
+		for_each(prefix, [&c](std::string_view, std::string_view) { c++; });
+		return c;
+	}
+
+private:
+	struct node {
+		uint64_t label_off = 0; // edge label from parent in strings
+		uint32_t label_len = 0;
+		uint32_t value_len = 0;
+		uint64_t value_off = 0;
+		bool has_value = false;
+		std::vector<uint32_t> children; // sorted by first byte of label
+	};
+
+	std::vector<node> nodes; // nodes[0] is root with empty label
+	std::string strings;
+	size_t count = 0;
+
+	uint64_t add_string(std::string_view s) {
+		uint64_t off = strings.size();
+		strings.append(s);
+		return off;
+	}
+
+	uint32_t new_node(uint64_t label_off, size_t label_len) {
+		nodes.emplace_back();
+		nodes.back().label_off = label_off;
+		nodes.back().label_len = static_cast<uint32_t>(label_len);
+		return static_cast<uint32_t>(nodes.size() - 1);
+	}
+
+	void set_value(uint32_t n, std::string_view value) {
+		nodes[n].value_off = add_string(value);
+		nodes[n].value_len = static_cast<uint32_t>(value.size());
+		nodes[n].has_value = true;
+		count++;
+	}
+
+	std::string_view label_of(uint32_t n) const {
+		return std::string_view(strings.data() + nodes[n].label_off, nodes[n].label_len);
+	}
+
+	std::string_view value_of(uint32_t n) const {
+		return std::string_view(strings.data() + nodes[n].value_off, nodes[n].value_len);
+	}
+
+	static size_t common_prefix(std::string_view a, std::string_view b) {
+		size_t n = std::min(a.size(), b.size());
+		size_t k = 0;
+		while (k < n && a[k] == b[k]) k++;
+		return k;
+	}
+
+	unsigned char first_of(uint32_t n) const {
+		return static_cast<unsigned char>(strings[nodes[n].label_off]);
+	}
+
+	// find child of n which label begins with c, *pos is its index (or
+	// index to insert it) in children of n
+	bool child(uint32_t n, char c, size_t *pos) const {
+		const std::vector<uint32_t> &children = nodes[n].children;
+		unsigned char b = static_cast<unsigned char>(c);
+		auto it = std::lower_bound(children.begin(), children.end(), b,
+			[this](uint32_t x, unsigned char v) { return first_of(x) < v; });
+		*pos = it - children.begin();
+		return it != children.end() && first_of(*it) == b;
+	}
+
+	template <class Fn>
+	void walk(uint32_t n, std::string *name, Fn &fn) const {
+		if (nodes[n].has_value) fn(std::string_view(*name), value_of(n));
+		for (uint32_t c : nodes[n].children) {
+			size_t len = name->size();
+			name->append(label_of(c));
+			walk(c, name, fn);
+			name->resize(len);
+		}
+	}
+};
+
+// Sink for conf_parse_block() which adds options to conf_tree
+struct conf_tree_sink {
+	conf_tree *ret;
+
+	void operator()(std::string_view name, std::string_view value) {
+		ret->insert(name, value);
+	}
+};
+
+// Parse config file file_name with [section] headers and dotted names
+// into radix tree, name of option in section is "section.name"
+// return 0 on success or some error code
+inline int parse_config_tree(std::string file_name, conf_tree *ret) {
+	if (!ret) return CONFERR_NORET;
+	ret->clear();
+
+	conf_tree_sink sink = { ret };
+	int err = conf_parse_file(file_name, sink, CONF_PARSE_SECTIONS);
+	if (err) ret->clear();
+	return err;
+} // parse_config_tree()
+
+// Parse config from memory buffer [data, data + size) into radix tree,
+// see parse_config_tree()
+// return 0 on success or some error code
+inline int parse_config_tree_buffer(const char *data, size_t size, conf_tree *ret) {
+	if (!ret) return CONFERR_NORET;
+	if (!data && size) return CONFERR_ERRFILE;
+	ret->clear();
+
+	conf_tree_sink sink = { ret };
+	int err = conf_parse_all(data, size, conf_buffer_name, sink, CONF_PARSE_SECTIONS);
+	if (err) ret->clear();
+	return err;
+} // parse_config_tree_buffer()
+
+/*
+// Example of usage
+int main() {
+	conf_tree conf;
+	if (parse_config_tree("test.conf", &conf) != 0) return -1;
+
+	std::string_view host = conf.get("db.primary.host", "localhost");
+
+	// all options of db.replica section
+	conf.for_each("db.replica.", [](std::string_view name, std::string_view value) {
+		std::cout << name << " = " << value << std::endl;
+	});
+}
+*/
+
+#endif /* CPP_PARSE_CONFIG_TREE_H */
@@ -0,0 +1,325 @@
+/*
+* cpp_parse_config_uring.hpp
+*
+* Bulk loading of many config files for cpp_parse_config.hpp through
+* Linux io_uring (Linux only). Opens and reads of many files are
+* submitted in batches with one system call, every file is parsed as
+* soon as its read completes. When io_uring is not available (old
+* kernel, disabled by sysctl or seccomp) blocking parse_config_batch()
+* is used instead. liburing is not needed, ring is set up by raw
+* system calls.
+*
+* Licensed under GNU General Public License v3
+*
+* Author: Kuzin Andrey <kuzinandrey@yandex.ru>
+* (c) 2021
+*/
+#ifndef CPP_PARSE_CONFIG_URING_H
+#define CPP_PARSE_CONFIG_URING_H
+
+#ifndef __linux__
+#error "cpp_parse_config_uring.hpp needs Linux io_uring"
+#endif
+
+#include "cpp_parse_config.hpp"
+#include "cpp_parse_config_parallel.hpp"
+
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+
+#ifndef CONF_URING_DEPTH
+#define CONF_URING_DEPTH 64 // files in flight at once
+#endif
+
+#ifndef CONF_URING_READ_SIZE
+#define CONF_URING_READ_SIZE 8192 // first read of file, buffer grows for bigger files
+#endif
+
+// Minimal io_uring: submission and completion rings mapped from kernel
+class conf_uring {
+public:
+	explicit conf_uring(unsigned entries) {
+		struct io_uring_params p;
+		std::memset(&p, 0, sizeof(p));
+		fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &p));
+		if (fd < 0) return;
+
+		sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+		cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+		bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+		if (single) sq_len = cq_len = std::max(sq_len, cq_len);
+
+		sq_ptr = mmap(NULL, sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+		if (sq_ptr == MAP_FAILED) { sq_ptr = nullptr; release(); return; }
+		cq_ptr = single ? sq_ptr
+			: mmap(NULL, cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (cq_ptr == MAP_FAILED) { cq_ptr = nullptr; release(); return; }
+		sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+		void *s = mmap(NULL, sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+		if (s == MAP_FAILED) { release(); return; }
+		sqes = static_cast<struct io_uring_sqe *>(s);
+
+		char *sq = static_cast<char *>(sq_ptr);
+		sq_head = reinterpret_cast<unsigned *>(sq + p.sq_off.head);
+		sq_tail = reinterpret_cast<unsigned *>(sq + p.sq_off.tail);
+		sq_mask = *reinterpret_cast<unsigned *>(sq + p.sq_off.ring_mask);
+		sq_entries = p.sq_entries;
+		sq_array = reinterpret_cast<unsigned *>(sq + p.sq_off.array);
+		char *cq = static_cast<char *>(cq_ptr);
+		cq_head = reinterpret_cast<unsigned *>(cq + p.cq_off.head);
+		cq_tail = reinterpret_cast<unsigned *>(cq + p.cq_off.tail);
+		cq_mask = *reinterpret_cast<unsigned *>(cq + p.cq_off.ring_mask);
+		cqes = reinterpret_cast<struct io_uring_cqe *>(cq + p.cq_off.cqes);
+		tail = *sq_tail;
+	}
+	conf_uring(const conf_uring &) = delete;
+	conf_uring &operator=(const conf_uring &) = delete;
+	~conf_uring() { release(); }
+
+	bool ok() const { return sqes != nullptr; }
+
+	// free submission entry (zeroed) or nullptr when queue is full
+	struct io_uring_sqe *get_sqe() {
+		unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+		if (tail - head >= sq_entries) return nullptr;
+		unsigned idx = tail & sq_mask;
+		sq_array[idx] = idx;
+		tail++;
+		struct io_uring_sqe *sqe = &sqes[idx];
+		std::memset(sqe, 0, sizeof(*sqe));
+		return sqe;
+	}
+
+	// submit queued entries and wait for at least wait_nr completions
+	// return 0 or -errno (-EAGAIN and -EBUSY: reap completions and retry)
+	int submit(unsigned wait_nr) {
+		__atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+		for (;;) {
+			long r = syscall(__NR_io_uring_enter, fd, queued(), wait_nr,
+				wait_nr ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+			if (r >= 0) return 0;
+			if (errno != EINTR) return -errno;
+		}
+	}
+
+	// wait for at least one completion without submitting anything
+	// return 0 or -errno
+	int wait() {
+		for (;;) {
+			long r = syscall(__NR_io_uring_enter, fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+			if (r >= 0) return 0;
+			if (errno != EINTR) return -errno;
+		}
+	}
+
+	// entries queued but not yet taken by kernel: kernel moves head of
+	// submission queue even when io_uring_enter() fails afterwards
+	unsigned queued() const { return tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE); }
+
+	// true if there is completion to take
+	bool completed() const {
+		return *cq_head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+	}
+
+	// take next completion into *cqe
+	// return false when there is no completion yet
+	bool next_cqe(struct io_uring_cqe *cqe) {
+		unsigned head = *cq_head;
+		if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) return false;
+		*cqe = cqes[head & cq_mask];
+		__atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+		return true;
+	}
+
+private:
+	int fd = -1;
+	void *sq_ptr = nullptr;
+	void *cq_ptr = nullptr;
+	size_t sq_len = 0;
+	size_t cq_len = 0;
+	size_t sqes_len = 0;
+	struct io_uring_sqe *sqes = nullptr;
+	unsigned *sq_head = nullptr;
+	unsigned *sq_tail = nullptr;
+	unsigned *sq_array = nullptr;
+	unsigned sq_mask = 0;
+	unsigned sq_entries = 0;
+	unsigned *cq_head = nullptr;
+	unsigned *cq_tail = nullptr;
+	unsigned cq_mask = 0;
+	struct io_uring_cqe *cqes = nullptr;
+	unsigned tail = 0; // local tail of submission queue
+
+	void release() {
+		if (sqes) { munmap(sqes, sqes_len); sqes = nullptr; }
+		if (cq_ptr && cq_ptr != sq_ptr) munmap(cq_ptr, cq_len);
+		if (sq_ptr) munmap(sq_ptr, sq_len);
+		sq_ptr = cq_ptr = nullptr;
+		if (fd >= 0) { close(fd); fd = -1; }
+	}
+};
+
+// Parse every file of files like parse_config_batch() but in calling
+// thread with up to depth files in flight in io_uring: open and read
+// requests of all slots go to kernel in one system call, file is
+// parsed when its read completes while reads of others go on.
+// Falls back to blocking parse_config_batch() when io_uring is not
+// available, and to blocking read of a file when its open fails.
+// return 0 if all files are parsed or error code of the first failed file
+inline int parse_config_batch_uring(const std::vector<std::string> &files,
+	std::vector<conf_file_result> *results, unsigned depth = CONF_URING_DEPTH)
+{
+	if (!results) return CONFERR_NORET;
+	if (depth < 1) depth = 1;
+
+	conf_uring ring(depth);
+	if (!ring.ok()) return parse_config_batch(files, results);
+
+	results->clear();
+	results->resize(files.size());
+
+	// one file in flight
+	struct slot {
+		size_t file;
+		int fd = -1;
+		size_t got = 0;
+		std::string buf;
+	};
+	std::vector<slot> slots(std::min<size_t>(depth, files.size()));
+	size_t next_file = 0;
+
+	// user_data of request: slot index and request kind in low bit
+	enum { req_open = 0, req_read = 1 };
+
+	std::vector<char> finished(files.size(), 0);
+	auto parse_buf = [&](size_t file, const std::string &buf, size_t size) {
+		conf_file_result &r = (*results)[file];
+		conf_map_sink sink = { &r.values };
+		r.err = conf_parse_all(buf.data(), size, files[file], sink);
+		if (r.err) r.values.clear();
+		finished[file] = 1;
+	};
+	auto load_blocking = [&](size_t file, std::string *buf) {
+		conf_file_result &r = (*results)[file];
+		r.values.clear();
+		r.err = conf_read_file(files[file], buf);
+		if (r.err) finished[file] = 1;
+		else parse_buf(file, *buf, buf->size());
+	};
+	auto queue_read = [&](size_t idx) {
+		slot &s = slots[idx];
+		if (s.got == s.buf.size()) s.buf.resize(s.buf.size() * 2);
+		struct io_uring_sqe *sqe = ring.get_sqe();
+		sqe->opcode = IORING_OP_READ;
+		sqe->fd = s.fd;
+		sqe->addr = reinterpret_cast<uint64_t>(&s.buf[s.got]);
+		sqe->len = static_cast<uint32_t>(s.buf.size() - s.got);
+		sqe->off = s.got;
+		sqe->user_data = (idx << 1) | req_read;
+	};
+	auto queue_open = [&](size_t idx) -> bool {
+		if (next_file >= files.size()) return false;
+		slot &s = slots[idx];
+		s.file = next_file++;
+		s.fd = -1;
+		s.got = 0;
+		if (s.buf.size() < CONF_URING_READ_SIZE) s.buf.resize(CONF_URING_READ_SIZE);
+		struct io_uring_sqe *sqe = ring.get_sqe();
+		sqe->opcode = IORING_OP_OPENAT;
+		sqe->fd = AT_FDCWD;
+		sqe->addr = reinterpret_cast<uint64_t>(files[s.file].c_str());
+		sqe->open_flags = O_RDONLY | O_CLOEXEC;
+		sqe->user_data = (idx << 1) | req_open;
+		return true;
+	};
+
+	// every slot has at most one request in flight, queue can't overflow
+	size_t in_flight = 0;
+	for (size_t i = 0; i < slots.size(); i++)
+		if (queue_open(i)) in_flight++;
+
+	while (in_flight) {
+		int e = ring.submit(1);
+		if (e == -EAGAIN || e == -EBUSY) {
+			// kernel is short of resources or completion queue is full:
+			// reap what is done, queued entries are submitted next time
+			if (!ring.completed()) std::this_thread::yield();
+		} else if (e) {
+			// ring is broken: requests already taken by kernel may still
+			// write into buffers of slots and open files, wait for them
+			unsigned outstanding = in_flight - ring.queued();
+			for (int tries = 0; outstanding && tries < 10000; ) {
+				struct io_uring_cqe cqe;
+				if (!ring.next_cqe(&cqe)) {
+					if (ring.wait() != 0) { usleep(1000); tries++; }
+					continue;
+				}
+				outstanding--;
+				if ((cqe.user_data & 1) == req_open && cqe.res >= 0) close(cqe.res);
+			}
+			for (slot &s : slots) if (s.fd >= 0) { close(s.fd); s.fd = -1; }
+			// kernel still holds buffers: never free them
+			if (outstanding) static_cast<void>(new std::vector<slot>(std::move(slots)));
+
+			// finish the rest with blocking reads
+			std::string buf;
+			for (size_t i = 0; i < files.size(); i++)
+				if (!finished[i]) load_blocking(i, &buf);
+			break;
+		}
+
+		struct io_uring_cqe cqe;
+		while (ring.next_cqe(&cqe)) {
+			size_t idx = cqe.user_data >> 1;
+			slot &s = slots[idx];
+			bool done = false;
+
+			if ((cqe.user_data & 1) == req_open) {
+				if (cqe.res < 0) {
+					// open may be not supported by this kernel: blocking way
+					load_blocking(s.file, &s.buf);
+					done = true;
+				} else {
+					s.fd = cqe.res;
+					queue_read(idx);
+				}
+			} else {
+				if (cqe.res < 0) {
+					(*results)[s.file].err = CONFERR_ERRFILE;
+					finished[s.file] = 1;
+					done = true;
+				} else if (cqe.res == 0) {
+					parse_buf(s.file, s.buf, s.got);
+					done = true;
+				} else {
+					// buffered read of io_uring may be short before end of
+					// file (partly cached pages, old kernels): only empty
+					// read is the end
+					s.got += cqe.res;
+					queue_read(idx);
+				}
+				if (done) { close(s.fd); s.fd = -1; }
+			}
+
+			if (done && !queue_open(idx)) in_flight--;
+		}
+	}
+
+	for (const conf_file_result &r : *results)
+		if (r.err) return r.err;
+	return 0;
+} // parse_config_batch_uring()
+
+/*
+// Example of usage
+int main() {
+	std::vector<std::string> files = { "tenant1.conf", "tenant2.conf", ... };
+	std::vector<conf_file_result> tenants;
+	if (parse_config_batch_uring(files, &tenants) != 0) {
+		for (size_t i = 0; i < files.size(); i++)
+			if (tenants[i].err) std::cerr << "Can't load " << files[i] << std::endl;
+	}
+}
+*/
+
+#endif /* CPP_PARSE_CONFIG_URING_H */
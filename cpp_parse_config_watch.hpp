@@ -0,0 +1,210 @@
+/*
+* cpp_parse_config_watch.hpp
+*
+* Hot reload of config file for cpp_parse_config.hpp (Linux only).
+* Watcher thread waits inotify events of config file (both writes in
+* place and atomic rename-over new file), parses it again and publishes
+* new immutable snapshot of options through conf_rcu holder, so readers
+* always see consistent config and never wait for reload.
+*
+* Licensed under GNU General Public License v3
+*
+* Author: Kuzin Andrey <kuzinandrey@yandex.ru>
+* (c) 2021
+*/
+#ifndef CPP_PARSE_CONFIG_WATCH_H
+#define CPP_PARSE_CONFIG_WATCH_H
+
+#ifndef __linux__
+#error "cpp_parse_config_watch.hpp needs Linux inotify"
+#endif
+
+#include "cpp_parse_config.hpp"
+#include "cpp_parse_config_diff.hpp"
+#include "cpp_parse_config_rcu.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+
+// Watch config file file_name and reload it on every change
+class conf_watcher {
+public:
+	typedef std::unordered_map<std::string,std::string> map_type;
+	typedef std::shared_ptr<const map_type> snapshot_type;
+	// called in watcher thread after every reload: err is 0 and now is
+	// new snapshot on success, on error now is the same as old
+	typedef std::function<void(const snapshot_type &old, const snapshot_type &now, int err)> reload_fn;
+
+	explicit conf_watcher(std::string file_name) : file_name(file_name) {
+		size_t slash = file_name.rfind('/');
+		if (slash == std::string::npos) {
+			dir_name = ".";
+			base_name = file_name;
+		} else {
+			dir_name = slash ? file_name.substr(0, slash) : "/";
+			base_name = file_name.substr(slash + 1);
+		}
+	}
+	conf_watcher(const conf_watcher &) = delete;
+	conf_watcher &operator=(const conf_watcher &) = delete;
+	~conf_watcher() { stop(); }
+
+	// set reload callback, call before start()
+	void on_reload(reload_fn fn) { reload_cb = fn; }
+
+	// callbacks called after reload only for changed options, may be
+	// used at any time: watcher.subscriptions().subscribe("log_level", fn)
+	conf_subscriptions &subscriptions() { return subs; }
+
+	// parse file first time and start watcher thread, errors of reloads
+	// in watcher thread go to error handler of thread calling start()
+	// return 0 on success or some error code
+	int start() {
+		if (thread.joinable()) return 0;
+		errors.to = conf_thread_error_handler();
+
+		int err = reload();
+		if (err) return err;
+
+		inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (inotify_fd < 0) return CONFERR_ERRFILE;
+		// watch directory: rename-over (IN_MOVED_TO) replaces inode of
+		// file itself; new file is read only when its writer closes it,
+		// not on creation when it is still empty
+		if (inotify_add_watch(inotify_fd, dir_name.c_str(),
+			IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+		{
+			close(inotify_fd); inotify_fd = -1;
+			return CONFERR_ERRFILE;
+		}
+		stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (stop_fd < 0) {
+			close(inotify_fd); inotify_fd = -1;
+			return CONFERR_ERRFILE;
+		}
+
+		thread = std::thread(&conf_watcher::run, this);
+		return 0;
+	}
+
+	// stop watcher thread, last snapshot stays available
+	void stop() {
+		if (thread.joinable()) {
+			uint64_t one = 1;
+			if (::write(stop_fd, &one, sizeof(one)) < 0) { /* counter of eventfd can't overflow here */ }
+			thread.join();
+		}
+		if (inotify_fd >= 0) { close(inotify_fd); inotify_fd = -1; }
+		if (stop_fd >= 0) { close(stop_fd); stop_fd = -1; }
+	}
+
+	// current config, never blocks on reload
+	snapshot_type snapshot() const { return *current.read(); }
+
+	// wait-free read section of current config without touching its
+	// reference counter: auto conf = watcher.read(); (*conf)->find(...)
+	conf_rcu<snapshot_type>::reader read() const { return current.read(); }
+
+	// number of successful loads
+	unsigned long generation() const { return gen.load(std::memory_order_acquire); }
+
+	// parse file now and publish new snapshot (also called by watcher thread)
+	// return 0 on success or some error code
+	int reload() {
+		std::lock_guard<std::mutex> lock(reload_mutex);
+
+		std::shared_ptr<map_type> fresh = std::make_shared<map_type>();
+		int err = parse_config(file_name, fresh.get());
+		snapshot_type old = *current.read();
+		if (!err) {
+			snapshot_type now = std::move(fresh);
+			current.update(new snapshot_type(now));
+			gen.fetch_add(1, std::memory_order_release);
+			if (reload_cb) reload_cb(old, now, 0);
+			// diff is computed once for all subscribers
+			if (old) subs.dispatch(*old, *now);
+		} else if (reload_cb) {
+			reload_cb(old, old, err);
+		}
+		return err;
+	}
+
+private:
+	std::string file_name;
+	std::string dir_name;
+	std::string base_name;
+	conf_rcu<snapshot_type> current{new snapshot_type()};
+	std::atomic<unsigned long> gen{0};
+	reload_fn reload_cb;
+	conf_subscriptions subs;
+	std::mutex reload_mutex; // serializes reloads, readers never take it
+	conf_error_relay errors; // handler of thread which called start()
+	std::thread thread;
+	int inotify_fd = -1;
+	int stop_fd = -1;
+
+	// true if some of inotify events in buffer is about our file
+	bool drain_events() {
+		alignas(struct inotify_event) char buf[4096];
+		bool hit = false;
+		for (;;) {
+			ssize_t len = ::read(inotify_fd, buf, sizeof(buf));
+			if (len <= 0) break;
+			for (char *p = buf; p < buf + len; ) {
+				struct inotify_event *ev = reinterpret_cast<struct inotify_event *>(p);
+				if (ev->len && base_name == ev->name) hit = true;
+				p += sizeof(struct inotify_event) + ev->len;
+			}
+		}
+		return hit;
+	}
+
+	void run() {
+		errors.install();
+		struct pollfd fds[2];
+		fds[0].fd = inotify_fd; fds[0].events = POLLIN;
+		fds[1].fd = stop_fd; fds[1].events = POLLIN;
+
+		for (;;) {
+			int n = poll(fds, 2, -1);
+			if (n < 0) {
+				if (errno == EINTR) continue;
+				break;
+			}
+			if (fds[1].revents) break;
+			// several events of one save are handled by one reload
+			if ((fds[0].revents & POLLIN) && drain_events()) reload();
+		}
+	}
+};
+
+/*
+// Example of usage
+int main() {
+	conf_watcher watcher("test.conf");
+	watcher.on_reload([](const conf_watcher::snapshot_type &, const conf_watcher::snapshot_type &now, int err) {
+		if (err) std::cerr << "Config is not reloaded, error " << err << std::endl;
+		else std::cout << "Config reloaded, " << now->size() << " options" << std::endl;
+	});
+	watcher.subscriptions().subscribe_prefix("db_", [](const conf_diff &) {
+		// only changes of db_* options get here
+	});
+	if (watcher.start() != 0) return -1;
+
+	for (;;) { // serving loop
+		auto conf = watcher.read(); // or watcher.snapshot() to keep it longer
+		auto host = (*conf)->find("host");
+		...
+	}
+}
+*/
+
+#endif /* CPP_PARSE_CONFIG_WATCH_H */
@@ -0,0 +1,75 @@
+/*
+* tests/test.hpp
+*
+* Common helpers of differential tests: random configs and checks.
+* Every test is one file, build and run it from tests directory:
+*   g++ -std=c++17 -O1 -g -fsanitize=address,undefined -pthread test_incremental.cpp -o test_incremental && ./test_incremental
+* Test prints "ok" and returns 0 or prints the failed input and returns 1.
+*
+* Licensed under GNU General Public License v3
+*
+* Author: Kuzin Andrey <kuzinandrey@yandex.ru>
+* (c) 2021
+*/
+#ifndef CPP_PARSE_CONFIG_TEST_H
+#define CPP_PARSE_CONFIG_TEST_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+#include <unistd.h>
+
+// print failed check with input which caused it and exit
+#define TEST_CHECK(cond, input) do { \
+	if (!(cond)) { \
+		std::printf("%s:%d: check failed: %s\ninput:\n%s\n", __FILE__, __LINE__, #cond, std::string(input).c_str()); \
+		std::exit(1); \
+	} \
+} while (0)
+
+// Random config of lines options with every syntax of parser: comments
+// with quotes and '=', blank lines, quoted values with new lines, name
+// and '=' on different lines, trailing comments, no final new line.
+// Names are few, so options repeat. With bad > 0 up to bad random
+// chars are inserted, which most likely make syntax errors.
+inline std::string test_random_config(std::mt19937 &r, int lines, int bad = 0) {
+	static const char *names[] = { "a", "bb", "host", "port", "user", "x1", "y_2", "zz" };
+	std::string s;
+	for (int i = 0; i < lines; i++) {
+		std::string name = names[r() % 8];
+		std::string v = std::to_string(r() % 5);
+		switch (r() % 12) {
+		case 0: s += "# comment \" = 1\n"; break;
+		case 1: s += "\n  \t"; break;
+		case 2: s += name + " = \"q\nv\n" + v + "\"\n"; break;
+		case 3: s += name + "\n\n = '" + v + "\n# x = 1\n'\n"; break;
+		case 4: s += name + " = " + v + " # c\n"; break;
+		default: s += name + (r() % 2 ? "=" : "  =  ") + v + "\n"; break;
+		}
+	}
+	if (r() % 3 == 0 && !s.empty()) s.pop_back();
+	for (int e = bad > 0 ? r() % (bad + 1) : 0; e > 0 && !s.empty(); e--)
+		s.insert(r() % s.size(), 1, "=\"'#\n!.$"[r() % 8]);
+	return s;
+} // test_random_config()
+
+// Write data into file_name, return false on error
+inline bool test_write_file(const std::string &file_name, const std::string &data) {
+	FILE *f = std::fopen(file_name.c_str(), "wb");
+	if (!f) return false;
+	bool ok = std::fwrite(data.data(), 1, data.size(), f) == data.size();
+	return std::fclose(f) == 0 && ok;
+} // test_write_file()
+
+// Name of new empty temporary file ("" on error), remove with unlink()
+inline std::string test_temp_file() {
+	char name[] = "/tmp/cpp_parse_config_test.XXXXXX";
+	int fd = mkstemp(name);
+	if (fd < 0) return std::string();
+	close(fd);
+	return name;
+} // test_temp_file()
+
+#endif /* CPP_PARSE_CONFIG_TEST_H */
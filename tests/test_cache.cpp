@@ -0,0 +1,177 @@
+/*
+* tests/test_cache.cpp
+*
+* Test of precompiled config cache: options of cache are the same as
+* of parse_config() for random configs, cache is compiled again when
+* source changes, touched source with the same text is accepted by hash,
+* damaged cache file is compiled again, cache keeps mode of source.
+* conf_cache_valid() is fuzzed with damaged headers and bytes (images
+* are exact-size heap copies, so sanitizer sees reads past end).
+*
+* Build and run from tests directory:
+*   g++ -std=c++17 -O1 -g -fsanitize=address,undefined test_cache.cpp -o test_cache
+*   ./test_cache [fuzz iterations]
+*
+* Licensed under GNU General Public License v3
+*
+* Author: Kuzin Andrey <kuzinandrey@yandex.ru>
+* (c) 2021
+*/
+#include "../cpp_parse_config_cache.hpp"
+#include "test.hpp"
+
+#include <memory>
+
+#include <sys/stat.h>
+
+// options of cache are the same as of map, in file order of text
+static bool same_options(const conf_cache &c, const std::unordered_map<std::string,std::string> &m) {
+	if (c.size() != m.size()) return false;
+	for (size_t i = 0; i < c.size(); i++) {
+		auto it = m.find(std::string(c.key(i)));
+		if (it == m.end() || it->second != c.value(i) || c.get(c.key(i)) != it->second) return false;
+	}
+	return !c.find("no_such_option");
+}
+
+// conf_cache_valid() of exact-size copy of image
+static bool valid_copy(const std::string &image) {
+	std::unique_ptr<char[]> exact(new char[image.size()]);
+	std::memcpy(exact.get(), image.data(), image.size());
+	return conf_cache_valid(exact.get(), image.size());
+}
+
+// put header h into image and fix checksum, so only fields are checked
+static void put_header(std::string *image, const conf_cache_header &h) {
+	std::memcpy(&(*image)[0], &h, sizeof(h));
+	uint64_t sum = conf_hash(std::string_view(image->data() + sizeof(h), image->size() - sizeof(h)));
+	std::memcpy(&(*image)[offsetof(conf_cache_header, checksum)], &sum, sizeof(sum));
+}
+
+static void set_mtime(const std::string &file_name, time_t sec) {
+	struct timespec times[2];
+	times[0].tv_sec = times[1].tv_sec = sec;
+	times[0].tv_nsec = times[1].tv_nsec = 0;
+	utimensat(AT_FDCWD, file_name.c_str(), times, 0);
+}
+
+int main(int argc, char *argv[]) {
+	int iterations = argc > 1 ? std::atoi(argv[1]) : 200000;
+	std::mt19937 r(11);
+	std::string file_name = test_temp_file();
+	TEST_CHECK(!file_name.empty(), "");
+	std::string cache_name = file_name + ".cache";
+
+	// random configs: cache holds the same options
+	for (int i = 0; i < 300; i++) {
+		std::string s = test_random_config(r, r() % 40);
+		std::unordered_map<std::string,std::string> ref;
+		if (parse_config_buffer(s, &ref) != 0) continue;
+		TEST_CHECK(test_write_file(file_name, s), s);
+		set_mtime(file_name, 1000000 + i); // every text is a change
+		conf_cache c;
+		TEST_CHECK(parse_config_cached(file_name, cache_name, &c) == 0 && c.mapped(), s);
+		TEST_CHECK(same_options(c, ref), s);
+	}
+
+	// the same size, other text and mtime: compiled again
+	std::unordered_map<std::string,std::string> ref;
+	conf_cache c;
+	TEST_CHECK(test_write_file(file_name, "host = a\n"), "");
+	set_mtime(file_name, 2000000);
+	TEST_CHECK(parse_config_cached(file_name, cache_name, &c) == 0 && c.get("host") == "a", "first");
+	TEST_CHECK(test_write_file(file_name, "host = b\n"), "");
+	set_mtime(file_name, 2000001);
+	TEST_CHECK(parse_config_cached(file_name, cache_name, &c) == 0 && c.get("host") == "b", "changed");
+
+	// touched only: accepted by hash and new mtime is stored
+	set_mtime(file_name, 2000002);
+	conf_cache_source src;
+	TEST_CHECK(conf_cache_stat(file_name, &src) == 0, "");
+	TEST_CHECK(conf_cache_open(cache_name, &src, file_name, &c) == 0 && c.get("host") == "b", "touched");
+	{
+		std::string image;
+		TEST_CHECK(conf_cache_read_text(cache_name, &image) == 0 && image.size() >= sizeof(conf_cache_header), "");
+		conf_cache_header h;
+		std::memcpy(&h, image.data(), sizeof(h));
+		TEST_CHECK(h.src_mtime_sec == 2000002, "mtime stored");
+	}
+
+	// damaged cache file: compiled again
+	{
+		std::string image;
+		TEST_CHECK(conf_cache_read_text(cache_name, &image) == 0, "");
+		image[image.size() - 2] ^= 1;
+		TEST_CHECK(test_write_file(cache_name, image), "");
+		TEST_CHECK(conf_cache_open(cache_name, &src, file_name, &c) != 0, "damaged cache accepted");
+		TEST_CHECK(parse_config_cached(file_name, cache_name, &c) == 0 && c.get("host") == "b", "recompiled");
+	}
+
+	// broken source: error, no options
+	TEST_CHECK(test_write_file(file_name, "1host = b\n"), "");
+	set_mtime(file_name, 2000003);
+	TEST_CHECK(parse_config_cached(file_name, cache_name, &c) == CONFERR_WRONGPARAM && c.size() == 0, "broken");
+
+	// cache is readable only by those who can read source
+	TEST_CHECK(test_write_file(file_name, "password = secret\n"), "");
+	chmod(file_name.c_str(), 0600);
+	TEST_CHECK(parse_config_cached(file_name, cache_name, &c) == 0 && c.get("password") == "secret", "secret");
+	struct stat sb;
+	TEST_CHECK(stat(cache_name.c_str(), &sb) == 0 && (sb.st_mode & 0777) == 0600, "cache mode");
+
+	// fuzz of header fields and bytes of valid image
+	std::unordered_map<std::string,std::string> src_map;
+	for (int i = 0; i < 50; i++) src_map["k" + std::to_string(i)] = std::string(i, 'v');
+	std::string image;
+	conf_cache_build(conf_flat_map(src_map), conf_cache_source(), 0, &image);
+	TEST_CHECK(valid_copy(image), "valid image");
+	for (size_t len = 0; len < image.size(); len += 1 + len / 4)
+		TEST_CHECK(!valid_copy(image.substr(0, len)), "truncated image");
+
+	{
+		// table as big as image: offsets computed from it wrap around
+		std::string b = image;
+		conf_cache_header h;
+		std::memcpy(&h, b.data(), sizeof(h));
+		uint64_t t = 1;
+		while (t * 2 <= b.size()) t *= 2;
+		h.table_size = t;
+		h.entries_off = h.slots_off + t * sizeof(conf_cache_slot);
+		h.strings_off = h.entries_off + h.count * sizeof(uint32_t);
+		h.strings_size = h.size - h.strings_off;
+		put_header(&b, h);
+		TEST_CHECK(!valid_copy(b), "wrapped offsets");
+	}
+
+	std::mt19937_64 r64(1);
+	int accepted = 0;
+	for (int i = 0; i < iterations; i++) {
+		std::string b = image;
+		conf_cache_header h;
+		std::memcpy(&h, b.data(), sizeof(h));
+		uint64_t *fields[] = { &h.count, &h.table_size, &h.entries_off, &h.strings_off, &h.strings_size };
+		int k = r64() % 7;
+		if (k < 5) {
+			switch (r64() % 3) {
+			case 0: *fields[k] = r64(); break;
+			case 1: *fields[k] = ~0ull - r64() % 4096; break; // wraps on add
+			default: *fields[k] = r64() % (2 * b.size()); break;
+			}
+			if (r64() % 2) { // consistent layout of damaged fields
+				h.entries_off = h.slots_off + h.table_size * sizeof(conf_cache_slot);
+				h.strings_off = h.entries_off + h.count * sizeof(uint32_t);
+				h.strings_size = h.size - h.strings_off;
+			}
+		} else {
+			size_t off = sizeof(h) + r64() % (b.size() - sizeof(h));
+			for (size_t j = 0; j < 8 && off + j < b.size(); j++) b[off + j] = static_cast<char>(r64());
+		}
+		put_header(&b, h);
+		if (valid_copy(b)) accepted++;
+	}
+
+	unlink(cache_name.c_str());
+	unlink(file_name.c_str());
+	std::printf("ok, %d of %d damaged images accepted\n", accepted, iterations);
+	return 0;
+}
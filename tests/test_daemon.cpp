@@ -0,0 +1,135 @@
+/*
+* tests/test_daemon.cpp
+*
+* Test of conf_daemon and conf_client over Unix socket: lookups, push
+* of new generation on reload and drop of client cache, failed reload
+* keeps old config and reports error to handler of start() caller, too
+* long keys are answered as not found without losing connection,
+* daemon is started again after stop(). Hang is failure (alarm).
+*
+* Build and run from tests directory:
+*   g++ -std=c++17 -O1 -g -fsanitize=address,undefined -pthread test_daemon.cpp -o test_daemon
+*   ./test_daemon
+*
+* Licensed under GNU General Public License v3
+*
+* Author: Kuzin Andrey <kuzinandrey@yandex.ru>
+* (c) 2021
+*/
+#include "../cpp_parse_config_daemon.hpp"
+#include "test.hpp"
+
+static std::atomic<int> handler_calls{0};
+
+static void count_error(const conf_error &, void *) { handler_calls++; }
+
+// get key until its value is want (pushes come asynchronously)
+static bool wait_value(conf_client *c, const std::string &key, const std::string &want) {
+	std::string v;
+	for (int i = 0; i < 500; i++) {
+		if (c->get(key, &v) == 0 && v == want) return true;
+		usleep(2000);
+	}
+	return false;
+}
+
+// send raw request of key with length len (only first bytes of key are
+// real, the rest is filler), then request of "host", return answers
+static std::string raw_requests(const std::string &socket_path, uint32_t len) {
+	struct sockaddr_un addr;
+	if (!conf_unix_addr(socket_path, &addr)) return std::string();
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0) {
+		if (fd >= 0) close(fd);
+		return std::string();
+	}
+	std::string req;
+	req.push_back(CONF_OP_GET);
+	conf_put<uint32_t>(&req, len);
+	req.append(len, 'k');
+	req.push_back(CONF_OP_GET);
+	conf_put<uint32_t>(&req, 4);
+	req += "host";
+	// small writes: key is split between many reads of daemon
+	for (size_t done = 0; done < req.size(); ) {
+		ssize_t n = send(fd, req.data() + done, std::min<size_t>(1000, req.size() - done), MSG_NOSIGNAL);
+		if (n <= 0) { close(fd); return std::string(); }
+		done += n;
+	}
+	// generation push (9 bytes), not found (14), host value (14 + 1)
+	std::string got;
+	char buf[256];
+	while (got.size() < 9 + 14 + 15) {
+		ssize_t n = recv(fd, buf, sizeof(buf), 0);
+		if (n <= 0) break;
+		got.append(buf, n);
+	}
+	close(fd);
+	return got;
+}
+
+int main() {
+	alarm(60);
+	std::string file_name = test_temp_file();
+	TEST_CHECK(!file_name.empty(), "");
+	std::string socket_path = file_name + ".sock";
+	TEST_CHECK(test_write_file(file_name, "host = a\nport = 1\n"), "");
+
+	conf_on_error(count_error);
+	conf_daemon daemon(file_name, socket_path);
+	TEST_CHECK(daemon.start() == 0 && daemon.generation() == 1, "start");
+
+	for (bool cached : { false, true }) {
+		conf_client c;
+		c.use_cache(cached);
+		TEST_CHECK(c.connect(socket_path) == 0, "connect");
+		std::string v;
+		TEST_CHECK(c.get("host", &v) == 0 && v == "a", "get host");
+		TEST_CHECK(c.get("host", &v) == 0 && v == "a", "get host again");
+		TEST_CHECK(c.get("nope", &v) == CONFERR_WRONGPARAM, "get nope");
+		TEST_CHECK(c.get(std::string(CONF_DAEMON_MAX_KEY + 1, 'x'), &v) == CONFERR_WRONGPARAM, "long key");
+		uint64_t gen = c.generation();
+
+		// reload is pushed, cached answer is dropped
+		TEST_CHECK(test_write_file(file_name, "host = b" + std::to_string(cached) + "\n"), "");
+		daemon.reload();
+		TEST_CHECK(wait_value(&c, "host", "b" + std::to_string(cached)), "reload");
+		TEST_CHECK(c.generation() > gen, "generation");
+		TEST_CHECK(c.get("port", &v) == CONFERR_WRONGPARAM, "removed option");
+
+		// broken file: old config is served, error goes to handler
+		int calls = handler_calls;
+		TEST_CHECK(test_write_file(file_name, "1host = c\n"), "");
+		daemon.reload();
+		for (int i = 0; i < 500 && daemon.last_error() == 0; i++) usleep(2000);
+		TEST_CHECK(daemon.last_error() == CONFERR_WRONGPARAM && handler_calls == calls + 1, "broken reload");
+		TEST_CHECK(c.get("host", &v) == 0 && v == "b" + std::to_string(cached), "old config");
+
+		TEST_CHECK(test_write_file(file_name, "host = a\n"), "");
+		daemon.reload();
+		TEST_CHECK(wait_value(&c, "host", "a"), "reload after error");
+	}
+
+	// too long key is skipped as it comes, next request is answered
+	std::string got = raw_requests(socket_path, 100000);
+	TEST_CHECK(got.size() == 9 + 14 + 15, "long key answers");
+	TEST_CHECK(got[0] == CONF_OP_GEN && got[9] == CONF_OP_VALUE && got[10] == 0, "long key not found");
+	TEST_CHECK(got[23] == CONF_OP_VALUE && got[24] == 1 && got[37] == 'a', "request after long key");
+
+	// started again after stop()
+	daemon.stop();
+	for (int i = 0; i < 2; i++) {
+		TEST_CHECK(daemon.start() == 0, "restart");
+		conf_client c;
+		std::string v;
+		TEST_CHECK(c.connect(socket_path) == 0 && c.get("host", &v) == 0 && v == "a", "get after restart");
+		daemon.stop();
+	}
+	conf_client c;
+	TEST_CHECK(c.connect(socket_path) != 0, "socket removed by stop()");
+
+	conf_on_error(nullptr);
+	unlink(file_name.c_str());
+	std::printf("ok\n");
+	return 0;
+}
@@ -0,0 +1,122 @@
+/*
+* tests/test_diagnostics.cpp
+*
+* Test of parse error reports: for random broken configs the handler is
+* called once with the code returned, line, column and char of error
+* agree with its offset, and every entry point (buffer, file read by
+* tiny blocks, parallel chunks, incremental update, batch workers)
+* reports the same position. Without handler nothing is reported.
+*
+* Build and run from tests directory:
+*   g++ -std=c++17 -O1 -g -fsanitize=address,undefined -pthread test_diagnostics.cpp -o test_diagnostics
+*   ./test_diagnostics [configs]
+*
+* Licensed under GNU General Public License v3
+*
+* Author: Kuzin Andrey <kuzinandrey@yandex.ru>
+* (c) 2021
+*/
+#define CONF_READ_BLOCK_SIZE 16
+#define CONF_PARALLEL_MIN_CHUNK 8
+#include "../cpp_parse_config_parallel.hpp"
+#include "../cpp_parse_config_diff.hpp"
+#include "test.hpp"
+
+// errors reported to handler, file_name is copied: it is valid only
+// during handler call
+struct reported {
+	conf_error err;
+	std::string file_name;
+};
+
+static std::vector<reported> got;
+
+static void collect(const conf_error &err, void *) {
+	got.push_back({ err, std::string(err.file_name) });
+	got.back().err.file_name = std::string_view();
+}
+
+static bool same_place(const conf_error &a, const conf_error &b, size_t shift = 0, int line_shift = 0) {
+	return a.code == b.code && a.offset == b.offset + shift && a.line == b.line + line_shift
+		&& a.column == b.column && a.c == b.c;
+}
+
+int main(int argc, char *argv[]) {
+	int configs = argc > 1 ? std::atoi(argv[1]) : 5000;
+	std::mt19937 r(3);
+	std::string file_name = test_temp_file();
+	TEST_CHECK(!file_name.empty(), "");
+	conf_on_error(collect);
+
+	int checked = 0;
+	std::vector<std::string> batch_files;
+	std::vector<conf_error> batch_ref;
+	for (int i = 0; i < configs; i++) {
+		std::string s = test_random_config(r, 1 + r() % 30);
+		s.insert(r() % (s.size() + 1), 1, "!.$"[r() % 3]);
+		std::unordered_map<std::string,std::string> m;
+
+		got.clear();
+		int err = parse_config_buffer(s, &m);
+		if (!err) {
+			TEST_CHECK(got.empty(), s);
+			continue;
+		}
+		TEST_CHECK(got.size() == 1 && got[0].err.code == err && got[0].file_name == conf_buffer_name, s);
+		conf_error ref = got[0].err;
+
+		// line, column and char agree with offset
+		int line = 1;
+		size_t line_begin = 0;
+		for (size_t k = 0; k < ref.offset; k++) if (s[k] == '\n') { line++; line_begin = k + 1; }
+		char c = ref.offset < s.size() ? s[ref.offset] : 0;
+		TEST_CHECK(ref.line == line && ref.column == static_cast<int>(ref.offset - line_begin + 1) && ref.c == c, s);
+
+		for (unsigned threads : { 2u, 5u }) {
+			got.clear();
+			TEST_CHECK(parse_config_parallel_buffer(s.data(), s.size(), &m, threads) == err, s);
+			TEST_CHECK(got.size() == 1 && same_place(got[0].err, ref), s);
+		}
+
+		TEST_CHECK(test_write_file(file_name, s), s);
+		got.clear();
+		TEST_CHECK(parse_config(file_name, &m) == err, s);
+		TEST_CHECK(got.size() == 1 && same_place(got[0].err, ref) && got[0].file_name == file_name, s);
+
+		// error after unchanged good prefix
+		conf_incremental inc;
+		std::string good = "a = 1\nbb = 2\n";
+		inc.update(good);
+		got.clear();
+		TEST_CHECK(inc.update(good + s) == err, s);
+		TEST_CHECK(got.size() == 1 && same_place(got[0].err, ref, good.size(), 2), good + s);
+
+		if (batch_files.size() < 64) {
+			batch_files.push_back(file_name + "." + std::to_string(batch_files.size()));
+			TEST_CHECK(test_write_file(batch_files.back(), s), s);
+			batch_ref.push_back(ref);
+		}
+		checked++;
+	}
+
+	// batch workers report to handler of calling thread
+	std::vector<conf_file_result> results;
+	got.clear();
+	TEST_CHECK(parse_config_batch(batch_files, &results, 4) != 0, "");
+	TEST_CHECK(got.size() == batch_files.size(), "");
+	for (const reported &rep : got) {
+		size_t k = std::strtoul(rep.file_name.c_str() + file_name.size() + 1, nullptr, 10);
+		TEST_CHECK(k < batch_ref.size() && same_place(rep.err, batch_ref[k]), rep.file_name);
+	}
+	for (const std::string &f : batch_files) unlink(f.c_str());
+
+	// silent by default
+	conf_on_error(nullptr);
+	got.clear();
+	std::unordered_map<std::string,std::string> m;
+	TEST_CHECK(parse_config_buffer("1bad = x", &m) != 0 && got.empty(), "1bad = x");
+
+	unlink(file_name.c_str());
+	std::printf("ok, %d errors checked\n", checked);
+	return 0;
+}
@@ -0,0 +1,82 @@
+/*
+* tests/test_incremental.cpp
+*
+* Differential test of conf_incremental: after every random edit of
+* config text (insert of option or char, erase of range) update() must
+* give the same error code as full parse_config_buffer() and on success
+* the same options, diff must be the same as conf_compute_diff() of
+* full parses.
+*
+* Build and run from tests directory:
+*   g++ -std=c++17 -O1 -g -fsanitize=address,undefined test_incremental.cpp -o test_incremental
+*   ./test_incremental [edits]
+*
+* Licensed under GNU General Public License v3
+*
+* Author: Kuzin Andrey <kuzinandrey@yandex.ru>
+* (c) 2021
+*/
+#include "../cpp_parse_config_diff.hpp"
+#include "test.hpp"
+
+#include <algorithm>
+
+// changes in one order to compare diffs
+static void sort_diff(conf_diff *d) {
+	std::sort(d->begin(), d->end(), [](const conf_change &a, const conf_change &b) {
+		return a.name < b.name;
+	});
+}
+
+int main(int argc, char *argv[]) {
+	int edits = argc > 1 ? std::atoi(argv[1]) : 20000;
+	std::mt19937 r(5);
+
+	std::string text;
+	for (int i = 0; i < 200; i++)
+		text += "k" + std::to_string(r() % 300) + " = " + (r() % 4 ? std::to_string(r() % 9) : "\"a\nb\"") + "\n";
+
+	conf_incremental inc;
+	std::unordered_map<std::string,std::string> prev;
+	TEST_CHECK(inc.update(text) == 0 && parse_config_buffer(text, &prev) == 0, text);
+
+	int applied = 0;
+	for (int i = 0; i < edits; i++) {
+		std::string t = text;
+		size_t pos = r() % (t.size() + 1);
+		switch (r() % 4) {
+		case 0: t.insert(pos, "k" + std::to_string(r() % 300) + "=" + std::to_string(r() % 9) + "\n"); break;
+		case 1: t.erase(pos, r() % 20); break;
+		case 2: t.insert(pos, 1, "=\"\n #x'"[r() % 7]); break;
+		default: t.insert(pos, test_random_config(r, 1 + r() % 3)); break;
+		}
+
+		std::unordered_map<std::string,std::string> ref;
+		int ref_err = parse_config_buffer(t, &ref);
+		conf_diff diff;
+		int err = inc.update(t, &diff);
+		TEST_CHECK(err == ref_err, t);
+		if (err) {
+			// previous generation is kept
+			TEST_CHECK(inc.values() == prev, t);
+			continue;
+		}
+		TEST_CHECK(inc.values() == ref, t);
+
+		conf_diff ref_diff;
+		conf_compute_diff(prev, ref, &ref_diff);
+		sort_diff(&diff);
+		sort_diff(&ref_diff);
+		TEST_CHECK(diff.size() == ref_diff.size(), t);
+		for (size_t k = 0; k < diff.size(); k++) {
+			TEST_CHECK(diff[k].kind == ref_diff[k].kind && diff[k].name == ref_diff[k].name
+				&& diff[k].old_value == ref_diff[k].old_value && diff[k].value == ref_diff[k].value, t);
+		}
+
+		text = t;
+		prev = std::move(ref);
+		applied++;
+	}
+	std::printf("ok, %d edits, %d applied\n", edits, applied);
+	return 0;
+}
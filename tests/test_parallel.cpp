@@ -0,0 +1,50 @@
+/*
+* tests/test_parallel.cpp
+*
+* Differential test of parse_config_parallel_buffer(): random configs
+* are cut into tiny chunks (CONF_PARALLEL_MIN_CHUNK is 8 bytes), so
+* chunk borders fall inside quoted values, comments and names waiting
+* for '='. Result and error code must be the same as of single-thread
+* parse_config_buffer() for any number of threads.
+*
+* Build and run from tests directory:
+*   g++ -std=c++17 -O1 -g -fsanitize=address,undefined -pthread test_parallel.cpp -o test_parallel
+*   ./test_parallel [configs]
+*
+* Licensed under GNU General Public License v3
+*
+* Author: Kuzin Andrey <kuzinandrey@yandex.ru>
+* (c) 2021
+*/
+#define CONF_PARALLEL_MIN_CHUNK 8
+#include "../cpp_parse_config_parallel.hpp"
+#include "test.hpp"
+
+int main(int argc, char *argv[]) {
+	int configs = argc > 1 ? std::atoi(argv[1]) : 20000;
+	std::mt19937 r(7);
+	std::string file_name = test_temp_file();
+	TEST_CHECK(!file_name.empty(), "");
+
+	long runs = 0, with_errors = 0;
+	for (int i = 0; i < configs; i++) {
+		std::string s = test_random_config(r, r() % 40, r() % 3 == 0 ? 2 : 0);
+		std::unordered_map<std::string,std::string> ref, m;
+		int ref_err = parse_config_buffer(s, &ref);
+		if (ref_err) with_errors++;
+
+		for (unsigned threads = 1; threads <= 9; threads += 2) {
+			int err = parse_config_parallel_buffer(s.data(), s.size(), &m, threads);
+			TEST_CHECK(err == ref_err && m == ref, s);
+			runs++;
+		}
+		if (i % 16 == 0) {
+			TEST_CHECK(test_write_file(file_name, s), s);
+			int err = parse_config_parallel(file_name, &m, 4);
+			TEST_CHECK(err == ref_err && m == ref, s);
+		}
+	}
+	unlink(file_name.c_str());
+	std::printf("ok, %ld runs, %ld configs with errors\n", runs, with_errors);
+	return 0;
+}
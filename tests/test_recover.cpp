@@ -0,0 +1,111 @@
+/*
+* tests/test_recover.cpp
+*
+* Differential test of recover mode: for random configs with several
+* errors conf_validate_buffer(), conf_validate() and
+* parse_config_collect() must report the same errors and keep the same
+* options as strict parser restarted on the line after every error.
+* Strict parse_config_buffer() must still stop on the first error.
+*
+* Build and run from tests directory:
+*   g++ -std=c++17 -O1 -g -fsanitize=address,undefined test_recover.cpp -o test_recover
+*   ./test_recover [configs]
+*
+* Licensed under GNU General Public License v3
+*
+* Author: Kuzin Andrey <kuzinandrey@yandex.ru>
+* (c) 2021
+*/
+#include "../cpp_parse_config.hpp"
+#include "test.hpp"
+
+static std::vector<conf_error> ref_errors;
+
+static void collect(const conf_error &err, void *) {
+	ref_errors.push_back(err);
+	ref_errors.back().file_name = std::string_view();
+}
+
+static bool same_errors(const std::vector<conf_error> &a, const std::vector<conf_error> &b) {
+	if (a.size() != b.size()) return false;
+	for (size_t i = 0; i < a.size(); i++) {
+		if (a[i].code != b[i].code || a[i].line != b[i].line || a[i].column != b[i].column
+			|| a[i].offset != b[i].offset || a[i].c != b[i].c) return false;
+	}
+	return true;
+}
+
+// Reference of recover mode: strict parser started again from the line
+// after error, errors into ref_errors, options into *ret
+// return code of the first error or 0
+static int restarted_parse(const std::string &s, std::unordered_map<std::string,std::string> *ret) {
+	ref_errors.clear();
+	ret->clear();
+	conf_map_sink sink = { ret };
+	conf_on_error(collect);
+
+	int first = 0;
+	size_t pos = 0;
+	int line = 1;
+	for (;;) {
+		conf_parser st;
+		st.line = line;
+		st.offset = st.line_offset = pos;
+		int err = conf_parse_block(&st, s.data() + pos, s.data() + s.size(), conf_buffer_name, sink);
+		if (!err) err = conf_parse_finish(&st, s.data() + s.size(), sink);
+		if (!err) break;
+		if (!first) first = err;
+		size_t nl = s.find('\n', ref_errors.back().offset);
+		if (nl == std::string::npos) break;
+		pos = nl + 1;
+		line = ref_errors.back().line + 1;
+	}
+	conf_on_error(nullptr);
+	return first;
+}
+
+int main(int argc, char *argv[]) {
+	int configs = argc > 1 ? std::atoi(argv[1]) : 20000;
+	std::mt19937 r(7);
+	std::string file_name = test_temp_file();
+	TEST_CHECK(!file_name.empty(), "");
+
+	size_t total_errors = 0;
+	for (int i = 0; i < configs; i++) {
+		std::string s = test_random_config(r, 1 + r() % 30, 5);
+		std::unordered_map<std::string,std::string> ref, m;
+		int first = restarted_parse(s, &ref);
+		total_errors += ref_errors.size();
+
+		std::vector<conf_error> errors;
+		TEST_CHECK(conf_validate_buffer(s.data(), s.size(), &errors) == first, s);
+		TEST_CHECK(same_errors(errors, ref_errors), s);
+
+		TEST_CHECK(test_write_file(file_name, s), s);
+		errors.clear();
+		TEST_CHECK(conf_validate(file_name, &errors) == first, s);
+		TEST_CHECK(same_errors(errors, ref_errors), s);
+
+		errors.clear();
+		TEST_CHECK(parse_config_collect(file_name, &m, &errors) == first, s);
+		TEST_CHECK(same_errors(errors, ref_errors) && m == ref, s);
+		for (const conf_error &err : errors) TEST_CHECK(err.file_name.empty(), s);
+
+		TEST_CHECK(parse_config_buffer(s, &m) == first, s);
+	}
+
+	// collector restores handler of thread, without vector errors go to it
+	int calls = 0;
+	conf_on_error([](const conf_error &, void *arg) { ++*static_cast<int *>(arg); }, &calls);
+	{
+		std::vector<conf_error> errors;
+		conf_validate_buffer("1\n2\n", 4, &errors);
+		TEST_CHECK(errors.size() == 2 && calls == 0, "1\n2\n");
+	}
+	TEST_CHECK(conf_validate_buffer("1\n2\nok=1\n$", 10, nullptr) != 0 && calls == 3, "1\n2\nok=1\n$");
+	conf_on_error(nullptr);
+
+	unlink(file_name.c_str());
+	std::printf("ok, %zu errors\n", total_errors);
+	return 0;
+}
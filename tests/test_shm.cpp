@@ -0,0 +1,99 @@
+/*
+* tests/test_shm.cpp
+*
+* Test of shared memory snapshots: reader follows new generations,
+* generation goes on after publisher restart, forked worker sees
+* publishes of master, remove() retires snapshot (reader keeps mapped
+* one) and leaves no objects, reader picks up publisher started after
+* remove(), objects get mode of publisher.
+*
+* Build and run from tests directory:
+*   g++ -std=c++17 -O1 -g -fsanitize=address,undefined test_shm.cpp -o test_shm -lrt
+*   ./test_shm
+*
+* Licensed under GNU General Public License v3
+*
+* Author: Kuzin Andrey <kuzinandrey@yandex.ru>
+* (c) 2021
+*/
+#include "../cpp_parse_config_shm.hpp"
+#include "test.hpp"
+
+#include <sys/wait.h>
+
+static conf_flat_map options(const std::string &host) {
+	conf_flat_map m;
+	m.insert("host", host);
+	m.insert("port", "80");
+	return m;
+}
+
+// access mode of shared memory object, -1 if there is none
+static int object_mode(const std::string &name) {
+	int fd = shm_open(name.c_str(), O_RDONLY, 0);
+	if (fd < 0) return -1;
+	struct stat sb;
+	int mode = fstat(fd, &sb) == 0 ? static_cast<int>(sb.st_mode & 0777) : -1;
+	close(fd);
+	return mode;
+}
+
+int main() {
+	alarm(60);
+	std::string name = "/cpp_parse_config_test." + std::to_string(getpid());
+	conf_shm_reader reader(name);
+	TEST_CHECK(reader.refresh() != 0, "nothing published");
+
+	{
+		conf_shm_publisher p(name);
+		TEST_CHECK(p.publish(options("a")) == 0 && p.generation() == 1, "publish a");
+		TEST_CHECK(reader.refresh() == 0 && reader.get("host") == "a" && reader.generation() == 1, "read a");
+		TEST_CHECK(!reader.changed(), "not changed");
+		TEST_CHECK(object_mode(name) == 0600 && object_mode(conf_shm_object_name(name, 1)) == 0600, "mode 0600");
+
+		TEST_CHECK(p.publish(options("b")) == 0, "publish b");
+		TEST_CHECK(reader.changed() && reader.get("host") == "a", "old generation until refresh");
+		TEST_CHECK(reader.refresh() == 0 && reader.get("host") == "b" && reader.generation() == 2, "read b");
+		TEST_CHECK(object_mode(conf_shm_object_name(name, 1)) == -1, "old generation unlinked");
+	}
+
+	// restarted publisher goes on with generations
+	conf_shm_publisher p(name);
+	TEST_CHECK(p.publish(options("c")) == 0 && p.generation() == 3, "restart");
+	TEST_CHECK(reader.changed() && reader.refresh() == 0 && reader.get("host") == "c", "read after restart");
+
+	// forked worker sees what master publishes
+	pid_t pid = fork();
+	if (pid == 0) {
+		conf_shm_reader worker(name);
+		for (int i = 0; i < 5000; i++) {
+			if (worker.refresh() == 0 && worker.get("host") == "d") _exit(0);
+			usleep(1000);
+		}
+		_exit(1);
+	}
+	TEST_CHECK(pid > 0, "fork");
+	TEST_CHECK(p.publish(options("d")) == 0, "publish d");
+	int status = 0;
+	TEST_CHECK(waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0, "worker");
+	TEST_CHECK(reader.refresh() == 0 && reader.get("host") == "d", "read d");
+
+	// removed: reader keeps mapped snapshot, no objects are left
+	uint64_t gen = p.generation();
+	p.remove();
+	TEST_CHECK(reader.refresh() != 0 && reader.get("host") == "d", "keep after remove");
+	TEST_CHECK(object_mode(name) == -1 && object_mode(conf_shm_object_name(name, gen)) == -1, "objects removed");
+
+	// new publisher after remove(): new control object from generation 1
+	conf_shm_publisher q(name, 0640);
+	TEST_CHECK(q.publish(options("e")) == 0 && q.generation() == 1, "publish after remove");
+	TEST_CHECK(reader.refresh() == 0 && reader.get("host") == "e" && reader.generation() == 1, "read new control");
+	TEST_CHECK(object_mode(name) == 0640 && object_mode(conf_shm_object_name(name, 1)) == 0640, "mode 0640");
+	conf_shm_reader fresh(name);
+	TEST_CHECK(fresh.refresh() == 0 && fresh.get("host") == "e" && fresh.get("port") == "80", "fresh reader");
+
+	q.remove();
+	TEST_CHECK(object_mode(name) == -1, "removed at end");
+	std::printf("ok\n");
+	return 0;
+}